@@ -0,0 +1,340 @@
+// sktoolslib - common files for SK tools
+
+// Copyright (C) 2026 - Stefan Kueng
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+#include "stdafx.h"
+#include "Base64.h"
+
+#if defined(_M_IX86) || defined(_M_X64)
+#    include <intrin.h>
+#    include <tmmintrin.h>
+
+// PF_SSSE3_INSTRUCTIONS_AVAILABLE is missing in older SDKs and older Windows
+// versions always report it as unavailable: ask the cpu directly
+static bool IsSSSE3Supported()
+{
+    int cpuInfo[4] = {};
+    __cpuid(cpuInfo, 1);
+    return (cpuInfo[2] & (1 << 9)) != 0;
+}
+
+static bool ssse3Supported = IsSSSE3Supported();
+#endif
+
+namespace
+{
+constexpr char standardChars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+constexpr char urlChars[]      = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+struct DecodeTable
+{
+    // the value of every char: -1 for invalid chars, -2 for the padding
+    signed char values[256];
+
+    constexpr DecodeTable(const char* chars)
+        : values{}
+    {
+        for (auto& value : values)
+            value = -1;
+        for (int i = 0; i < 64; ++i)
+            values[static_cast<unsigned char>(chars[i])] = static_cast<signed char>(i);
+        values[static_cast<unsigned char>('=')] = -2;
+    }
+};
+
+constexpr DecodeTable standardTable(standardChars);
+constexpr DecodeTable urlTable(urlChars);
+
+const char* Chars(CBase64::Alphabet alphabet)
+{
+    return (alphabet == CBase64::Alphabet::Url) ? urlChars : standardChars;
+}
+
+const DecodeTable& Table(CBase64::Alphabet alphabet)
+{
+    return (alphabet == CBase64::Alphabet::Url) ? urlTable : standardTable;
+}
+
+// encodes the complete groups of three bytes, returns the number of bytes encoded
+size_t EncodeBlocks(const BYTE* src, size_t len, char* dst, CBase64::Alphabet alphabet)
+{
+    const char* chars = Chars(alphabet);
+    size_t      i     = 0;
+#if defined(_M_IX86) || defined(_M_X64)
+    if (ssse3Supported)
+    {
+        // splits 12 bytes into 16 values of 6 bits, then adds the offset of
+        // the value range ('A', 'a', '0' or the two extra chars) to each value
+        const __m128i spread   = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+        const __m128i offsets  = (alphabet == CBase64::Alphabet::Url)
+                                     ? _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '-' - 62, '_' - 63, 'A', 0, 0)
+                                     : _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+        for (; i + 16 <= len; i += 12, dst += 16)
+        {
+            __m128i in      = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), spread);
+            __m128i t0      = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+            __m128i t1      = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+            __m128i values  = _mm_or_si128(t0, t1);
+            // 0-25 -> 13, 26-51 -> 0, 52-61 -> 1-10, 62 -> 11, 63 -> 12
+            __m128i range   = _mm_subs_epu8(values, _mm_set1_epi8(51));
+            range           = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), values), _mm_set1_epi8(13)));
+            __m128i encoded = _mm_add_epi8(values, _mm_shuffle_epi8(offsets, range));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), encoded);
+        }
+    }
+#endif
+    for (; i + 3 <= len; i += 3, dst += 4)
+    {
+        UINT32 v = (src[i] << 16) | (src[i + 1] << 8) | src[i + 2];
+        dst[0]   = chars[v >> 18];
+        dst[1]   = chars[(v >> 12) & 0x3F];
+        dst[2]   = chars[(v >> 6) & 0x3F];
+        dst[3]   = chars[v & 0x3F];
+    }
+    return i;
+}
+
+// encodes the last one or two bytes, returns the number of chars written
+size_t EncodeTail(const BYTE* src, size_t len, char* dst, CBase64::Alphabet alphabet, bool padding)
+{
+    if (len == 0)
+        return 0;
+    const char* chars = Chars(alphabet);
+    UINT32      v     = (src[0] << 16) | ((len > 1) ? (src[1] << 8) : 0);
+    dst[0]            = chars[v >> 18];
+    dst[1]            = chars[(v >> 12) & 0x3F];
+    if (len > 1)
+        dst[2] = chars[(v >> 6) & 0x3F];
+    size_t count = len + 1;
+    while (padding && (count < 4))
+        dst[count++] = '=';
+    return count;
+}
+
+// decodes groups of four valid chars and stops at the first group with an
+// invalid char or padding. \c dst needs room for len / 4 * 3 + 4 bytes.
+// Returns the number of chars decoded.
+size_t DecodeBlocks(const char* src, size_t len, BYTE* dst, CBase64::Alphabet alphabet)
+{
+    const DecodeTable& table = Table(alphabet);
+    size_t             i     = 0;
+#if defined(_M_IX86) || defined(_M_X64)
+    if (ssse3Supported)
+    {
+        const char    c62    = (alphabet == CBase64::Alphabet::Url) ? '-' : '+';
+        const char    c63    = (alphabet == CBase64::Alphabet::Url) ? '_' : '/';
+        const __m128i gather = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+        for (; i + 16 <= len; i += 16, dst += 12)
+        {
+            __m128i in    = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('A' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), in));
+            __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('a' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), in));
+            __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('0' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), in));
+            __m128i is62  = _mm_cmpeq_epi8(in, _mm_set1_epi8(c62));
+            __m128i is63  = _mm_cmpeq_epi8(in, _mm_set1_epi8(c63));
+            if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, is62)), is63)) != 0xFFFF)
+                break;
+            __m128i shift = _mm_or_si128(_mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-'A')), _mm_and_si128(lower, _mm_set1_epi8(26 - 'a'))),
+                                         _mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(52 - '0')),
+                                                      _mm_or_si128(_mm_and_si128(is62, _mm_set1_epi8(static_cast<char>(62 - c62))), _mm_and_si128(is63, _mm_set1_epi8(static_cast<char>(63 - c63))))));
+            __m128i values = _mm_add_epi8(in, shift);
+            // join the four 6 bit values of every dword to 24 bits, then drop the fourth byte
+            __m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+            __m128i packed = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_shuffle_epi8(packed, gather));
+        }
+    }
+#endif
+    for (; i + 4 <= len; i += 4, dst += 3)
+    {
+        int a = table.values[static_cast<unsigned char>(src[i])];
+        int b = table.values[static_cast<unsigned char>(src[i + 1])];
+        int c = table.values[static_cast<unsigned char>(src[i + 2])];
+        int d = table.values[static_cast<unsigned char>(src[i + 3])];
+        if ((a | b | c | d) < 0)
+            break;
+        UINT32 v = (a << 18) | (b << 12) | (c << 6) | d;
+        dst[0]   = static_cast<BYTE>(v >> 16);
+        dst[1]   = static_cast<BYTE>(v >> 8);
+        dst[2]   = static_cast<BYTE>(v);
+    }
+    return i;
+}
+} // namespace
+
+size_t CBase64::EncodedLength(size_t len, bool padding)
+{
+    if (padding)
+        return (len + 2) / 3 * 4;
+    return len / 3 * 4 + ((len % 3) ? (len % 3) + 1 : 0);
+}
+
+std::string CBase64::Encode(const BYTE* data, size_t len, Alphabet alphabet, bool padding)
+{
+    std::string out(EncodedLength(len, padding), '\0');
+    size_t      done = EncodeBlocks(data, len, out.data(), alphabet);
+    EncodeTail(data + done, len - done, out.data() + done / 3 * 4, alphabet, padding);
+    return out;
+}
+
+bool CBase64::Decode(std::string_view text, std::string& out, Alphabet alphabet)
+{
+    CBase64Decoder decoder(alphabet);
+    return decoder.Decode(text.data(), text.size(), out) && decoder.Finish(out);
+}
+
+CBase64Encoder::CBase64Encoder(CBase64::Alphabet alphabet, bool padding)
+    : alphabet(alphabet)
+    , padding(padding)
+    , pending{}
+    , pendingCount(0)
+{
+}
+
+void CBase64Encoder::Encode(const BYTE* data, size_t len, std::string& out)
+{
+    size_t i = 0;
+    if (pendingCount > 0)
+    {
+        while ((pendingCount < 3) && (i < len))
+            pending[pendingCount++] = data[i++];
+        if (pendingCount < 3)
+            return;
+        size_t oldSize = out.size();
+        out.resize(oldSize + 4);
+        EncodeBlocks(pending, 3, out.data() + oldSize, alphabet);
+        pendingCount = 0;
+    }
+    size_t full = (len - i) / 3 * 3;
+    if (full > 0)
+    {
+        size_t oldSize = out.size();
+        out.resize(oldSize + full / 3 * 4);
+        EncodeBlocks(data + i, full, out.data() + oldSize, alphabet);
+        i += full;
+    }
+    while (i < len)
+        pending[pendingCount++] = data[i++];
+}
+
+void CBase64Encoder::Finish(std::string& out)
+{
+    char tail[4];
+    out.append(tail, EncodeTail(pending, pendingCount, tail, alphabet, padding));
+    pendingCount = 0;
+}
+
+CBase64Decoder::CBase64Decoder(CBase64::Alphabet alphabet)
+    : alphabet(alphabet)
+    , pending{}
+    , pendingCount(0)
+    , padded(false)
+    , failed(false)
+{
+}
+
+void CBase64Decoder::Reset()
+{
+    pendingCount = 0;
+    padded       = false;
+    failed       = false;
+}
+
+bool CBase64Decoder::DecodeGroup(const char* group, std::string& out)
+{
+    const DecodeTable& table = Table(alphabet);
+    int                values[4];
+    size_t             valid = 0;
+    while ((valid < 4) && ((values[valid] = table.values[static_cast<unsigned char>(group[valid])]) >= 0))
+        ++valid;
+    UINT32 v = 0;
+    for (size_t k = 0; k < valid; ++k)
+        v |= values[k] << (18 - 6 * k);
+    // the valid chars are decoded even if the group is invalid
+    const char bytes[3] = {static_cast<char>(v >> 16), static_cast<char>(v >> 8), static_cast<char>(v)};
+    out.append(bytes, (valid >= 2) ? valid - 1 : 0);
+    if (valid == 4)
+        return true;
+
+    bool padding = (valid >= 2);
+    for (size_t k = valid; k < 4; ++k)
+        padding = padding && (group[k] == '=');
+    if (!padding)
+    {
+        failed = true;
+        return false;
+    }
+    padded = true;
+    return true;
+}
+
+bool CBase64Decoder::Decode(const char* text, size_t len, std::string& out)
+{
+    if (failed)
+        return false;
+    size_t i = 0;
+    if (pendingCount > 0)
+    {
+        while ((pendingCount < 4) && (i < len))
+            pending[pendingCount++] = text[i++];
+        if (pendingCount < 4)
+            return true;
+        pendingCount = 0;
+        if (!DecodeGroup(pending, out))
+            return false;
+    }
+    while (i < len)
+    {
+        if (padded)
+        {
+            // nothing may follow the padding
+            failed = true;
+            return false;
+        }
+        size_t full = (len - i) / 4 * 4;
+        if (full == 0)
+            break;
+        size_t oldSize = out.size();
+        out.resize(oldSize + full / 4 * 3 + 4);
+        size_t decoded = DecodeBlocks(text + i, full, reinterpret_cast<BYTE*>(out.data() + oldSize), alphabet);
+        out.resize(oldSize + decoded / 4 * 3);
+        i += decoded;
+        if (decoded < full)
+        {
+            if (!DecodeGroup(text + i, out))
+                return false;
+            i += 4;
+        }
+    }
+    while (i < len)
+        pending[pendingCount++] = text[i++];
+    return true;
+}
+
+bool CBase64Decoder::Finish(std::string& out)
+{
+    if (failed)
+        return false;
+    if (pendingCount == 0)
+        return true;
+    // unpadded input ends with two or three chars
+    while (pendingCount < 4)
+        pending[pendingCount++] = '=';
+    pendingCount = 0;
+    return DecodeGroup(pending, out);
+}
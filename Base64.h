@@ -0,0 +1,88 @@
+// sktoolslib - common files for SK tools
+
+// Copyright (C) 2026 - Stefan Kueng
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+/**
+ * base64 encoding and decoding with the standard and the URL safe alphabet.
+ * Blocks of 12 bytes are encoded to 16 chars and back with SSSE3.
+ * Decoding accepts input with or without padding, and stops at the first
+ * char that's not part of the alphabet.
+ */
+class CBase64
+{
+public:
+    enum class Alphabet
+    {
+        Standard, ///< '+' and '/' for 62 and 63
+        Url,      ///< '-' and '_' for 62 and 63
+    };
+
+    /// returns the number of chars Encode() creates for \c len bytes
+    static size_t      EncodedLength(size_t len, bool padding = true);
+    static std::string Encode(const BYTE* data, size_t len, Alphabet alphabet = Alphabet::Standard, bool padding = true);
+    /// appends the decoded bytes to \c out.
+    /// \return false if the text is not valid base64. \c out then has the bytes up to the first invalid char.
+    static bool        Decode(std::string_view text, std::string& out, Alphabet alphabet = Alphabet::Standard);
+};
+
+/// encodes data that arrives in chunks, the result is the same as
+/// CBase64::Encode() of all the data
+class CBase64Encoder
+{
+public:
+    CBase64Encoder(CBase64::Alphabet alphabet = CBase64::Alphabet::Standard, bool padding = true);
+
+    /// appends the chars for the complete groups of three bytes to \c out
+    void Encode(const BYTE* data, size_t len, std::string& out);
+    /// appends the chars for the bytes left, and resets the encoder
+    void Finish(std::string& out);
+
+private:
+    CBase64::Alphabet alphabet;
+    bool              padding;
+    BYTE              pending[3];
+    size_t            pendingCount;
+};
+
+/// decodes base64 text that arrives in chunks
+class CBase64Decoder
+{
+public:
+    CBase64Decoder(CBase64::Alphabet alphabet = CBase64::Alphabet::Standard);
+
+    /// appends the decoded bytes to \c out.
+    /// \return false for invalid input, all following calls then fail until Reset() is called
+    bool Decode(const char* text, size_t len, std::string& out);
+    /// decodes the chars left over from the last chunk
+    bool Finish(std::string& out);
+    void Reset();
+
+private:
+    bool DecodeGroup(const char* group, std::string& out);
+
+    CBase64::Alphabet alphabet;
+    char              pending[4];
+    size_t            pendingCount;
+    bool              padded;
+    bool              failed;
+};
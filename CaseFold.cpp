@@ -0,0 +1,323 @@
+// sktoolslib - common files for SK tools
+
+// Copyright (C) 2026 - Stefan Kueng
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+#include "stdafx.h"
+#include "CaseFold.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#    include <emmintrin.h>
+#    include <intrin.h>
+#endif
+
+static BOOL sse2Supported = ::IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE);
+
+namespace
+{
+struct FoldTables
+{
+    wchar_t fold[0x10000];
+    bool    nonAsciiFold[0x80];
+};
+
+void MapRange(FoldTables& tables, wchar_t first, wchar_t last)
+{
+    int  count = last - first + 1;
+    auto src   = std::make_unique<wchar_t[]>(count);
+    auto dst   = std::make_unique<wchar_t[]>(count);
+    for (int i = 0; i < count; ++i)
+        src[i] = static_cast<wchar_t>(first + i);
+    // lower casing maps every code unit to exactly one code unit, if that's
+    // not the case the chars are left as they are
+    if (LCMapStringEx(LOCALE_NAME_INVARIANT, LCMAP_LOWERCASE, src.get(), count, dst.get(), count, nullptr, nullptr, 0) == count)
+        memcpy(&tables.fold[first], dst.get(), count * sizeof(wchar_t));
+}
+
+std::unique_ptr<FoldTables> BuildTables()
+{
+    auto tables = std::make_unique<FoldTables>();
+    for (size_t c = 0; c < 0x10000; ++c)
+        tables->fold[c] = static_cast<wchar_t>(c);
+    for (wchar_t c = 'A'; c <= 'Z'; ++c)
+        tables->fold[c] = c | 0x20;
+    // surrogates can't be mapped on their own
+    MapRange(*tables, 0x80, 0xD7FF);
+    MapRange(*tables, 0xE000, 0xFFFF);
+    for (size_t c = 0x80; c < 0x10000; ++c)
+    {
+        if (tables->fold[c] < 0x80)
+            tables->nonAsciiFold[tables->fold[c]] = true;
+    }
+    return tables;
+}
+
+const FoldTables& GetTables()
+{
+    static const std::unique_ptr<FoldTables> tables = BuildTables();
+    return *tables;
+}
+
+constexpr uint64_t wideLanes      = 0x0001000100010001ULL;
+constexpr uint64_t narrowLanes    = 0x0101010101010101ULL;
+constexpr uint64_t hashMultiplier = 0x9E3779B97F4A7C15ULL;
+
+// folds the ASCII upper case letters in all lanes of x at once.
+// Every lane must be below 0x80, so adding 0x3F can't carry into the next lane.
+inline uint64_t FoldAsciiLanes(uint64_t x, uint64_t lanes)
+{
+    uint64_t aboveA = x + lanes * (0x80 - 'A');
+    uint64_t aboveZ = x + lanes * (0x80 - 'Z' - 1);
+    return x | ((aboveA & ~aboveZ & (lanes * 0x80)) >> 2);
+}
+
+inline char FoldAscii(char c)
+{
+    return ((c >= 'A') && (c <= 'Z')) ? (c | 0x20) : c;
+}
+
+// packs up to four folded chars the same way a little endian load would
+inline uint64_t FoldChunk(const wchar_t* s, size_t count)
+{
+    uint64_t chunk = 0;
+    for (size_t i = 0; i < count; ++i)
+        chunk |= static_cast<uint64_t>(static_cast<uint16_t>(CCaseFold::Fold(s[i]))) << (16 * i);
+    return chunk;
+}
+
+inline uint64_t FoldChunk(const char* s, size_t count)
+{
+    uint64_t chunk = 0;
+    for (size_t i = 0; i < count; ++i)
+        chunk |= static_cast<uint64_t>(static_cast<uint8_t>(FoldAscii(s[i]))) << (8 * i);
+    return chunk;
+}
+
+inline uint64_t MixChunk(uint64_t h, uint64_t chunk)
+{
+    h = (h ^ chunk) * hashMultiplier;
+    return h ^ (h >> 29);
+}
+} // namespace
+
+const wchar_t* CCaseFold::GetTable()
+{
+    return GetTables().fold;
+}
+
+size_t CCaseFold::Hash(std::wstring_view s)
+{
+    static_assert(sizeof(wchar_t) == sizeof(uint16_t));
+    auto     p = s.data();
+    auto     n = s.size();
+    uint64_t h = MixChunk(0, n);
+    for (; n >= 4; p += 4, n -= 4)
+    {
+        uint64_t chunk;
+        memcpy(&chunk, p, sizeof(chunk));
+        if ((chunk & (wideLanes * 0xFF80)) == 0)
+            chunk = FoldAsciiLanes(chunk, wideLanes);
+        else
+            chunk = FoldChunk(p, 4);
+        h = MixChunk(h, chunk);
+    }
+    if (n)
+        h = MixChunk(h, FoldChunk(p, n));
+    return static_cast<size_t>(h ^ (h >> 32));
+}
+
+size_t CCaseFold::Hash(std::string_view s)
+{
+    auto     p = s.data();
+    auto     n = s.size();
+    uint64_t h = MixChunk(0, n);
+    for (; n >= 8; p += 8, n -= 8)
+    {
+        uint64_t chunk;
+        memcpy(&chunk, p, sizeof(chunk));
+        if ((chunk & (narrowLanes * 0x80)) == 0)
+            chunk = FoldAsciiLanes(chunk, narrowLanes);
+        else
+            chunk = FoldChunk(p, 8);
+        h = MixChunk(h, chunk);
+    }
+    if (n)
+        h = MixChunk(h, FoldChunk(p, n));
+    return static_cast<size_t>(h ^ (h >> 32));
+}
+
+bool CCaseFold::Equal(std::wstring_view a, std::wstring_view b)
+{
+    if (a.size() != b.size())
+        return false;
+    size_t i = 0;
+    for (; i + 4 <= a.size(); i += 4)
+    {
+        uint64_t x, y;
+        memcpy(&x, a.data() + i, sizeof(x));
+        memcpy(&y, b.data() + i, sizeof(y));
+        if (x == y)
+            continue;
+        if (((x | y) & (wideLanes * 0xFF80)) == 0)
+        {
+            if (FoldAsciiLanes(x, wideLanes) != FoldAsciiLanes(y, wideLanes))
+                return false;
+        }
+        else if (FoldChunk(a.data() + i, 4) != FoldChunk(b.data() + i, 4))
+            return false;
+    }
+    for (; i < a.size(); ++i)
+    {
+        if (Fold(a[i]) != Fold(b[i]))
+            return false;
+    }
+    return true;
+}
+
+bool CCaseFold::Equal(std::string_view a, std::string_view b)
+{
+    if (a.size() != b.size())
+        return false;
+    size_t i = 0;
+    for (; i + 8 <= a.size(); i += 8)
+    {
+        uint64_t x, y;
+        memcpy(&x, a.data() + i, sizeof(x));
+        memcpy(&y, b.data() + i, sizeof(y));
+        if (x == y)
+            continue;
+        if (((x | y) & (narrowLanes * 0x80)) == 0)
+        {
+            if (FoldAsciiLanes(x, narrowLanes) != FoldAsciiLanes(y, narrowLanes))
+                return false;
+        }
+        else if (FoldChunk(a.data() + i, 8) != FoldChunk(b.data() + i, 8))
+            return false;
+    }
+    for (; i < a.size(); ++i)
+    {
+        if (FoldAscii(a[i]) != FoldAscii(b[i]))
+            return false;
+    }
+    return true;
+}
+
+bool CCaseFold::HasNonAsciiFold(wchar_t c)
+{
+    return (c < 0x80) && GetTables().nonAsciiFold[c];
+}
+
+CCaseInsensitiveSearcher::CCaseInsensitiveSearcher(std::wstring_view needle)
+    : needle(needle)
+    , table(CCaseFold::GetTable())
+    , useSSE2(false)
+{
+    size_t m = this->needle.size();
+    for (auto& c : this->needle)
+        c = table[c];
+
+    std::fill(std::begin(skip), std::end(skip), m);
+    for (size_t j = 0; j + 1 < m; ++j)
+        skip[this->needle[j] & 0xFF] = m - 1 - j;
+
+#if defined(_M_IX86) || defined(_M_X64)
+    // the SSE2 compare folds only ASCII chars
+    if (sse2Supported && (m > 0))
+    {
+        wchar_t first = this->needle.front();
+        wchar_t last  = this->needle.back();
+        useSSE2       = (first < 0x80) && (last < 0x80) && !CCaseFold::HasNonAsciiFold(first) && !CCaseFold::HasNonAsciiFold(last);
+    }
+#endif
+}
+
+size_t CCaseInsensitiveSearcher::Find(std::wstring_view haystack, size_t start) const
+{
+    if ((start > haystack.size()) || (haystack.size() - start < needle.size()))
+        return std::wstring_view::npos;
+    if (needle.empty())
+        return start;
+    if (useSSE2)
+        return FindSSE2(haystack, start);
+    return FindHorspool(haystack, start);
+}
+
+bool CCaseInsensitiveSearcher::Matches(const wchar_t* text) const
+{
+    for (size_t i = 0; i < needle.size(); ++i)
+    {
+        if (table[text[i]] != needle[i])
+            return false;
+    }
+    return true;
+}
+
+size_t CCaseInsensitiveSearcher::FindSSE2(std::wstring_view haystack, size_t start) const
+{
+    size_t         m    = needle.size();
+    size_t         n    = haystack.size();
+    const wchar_t* text = haystack.data();
+    size_t         i    = start;
+#if defined(_M_IX86) || defined(_M_X64)
+    // or-ing 0x20 turns 'A'-'Z' into 'a'-'z' and keeps all other
+    // code units from being equal to a lower case letter
+    auto          foldMask  = [](wchar_t c) { return static_cast<short>(((c >= 'a') && (c <= 'z')) ? 0x20 : 0); };
+    const __m128i firstChar = _mm_set1_epi16(static_cast<short>(needle.front()));
+    const __m128i lastChar  = _mm_set1_epi16(static_cast<short>(needle.back()));
+    const __m128i firstFold = _mm_set1_epi16(foldMask(needle.front()));
+    const __m128i lastFold  = _mm_set1_epi16(foldMask(needle.back()));
+    for (; i + m - 1 + 8 <= n; i += 8)
+    {
+        __m128i firstChars = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i)), firstFold);
+        __m128i lastChars  = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + m - 1)), lastFold);
+        int     mask       = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi16(firstChars, firstChar), _mm_cmpeq_epi16(lastChars, lastChar)));
+        unsigned long bit  = 0;
+        while (_BitScanForward(&bit, mask))
+        {
+            if (Matches(text + i + bit / 2))
+                return i + bit / 2;
+            mask &= ~(3 << bit); // two bits per char
+        }
+    }
+#endif
+    for (; i + m <= n; ++i)
+    {
+        if (Matches(text + i))
+            return i;
+    }
+    return std::wstring_view::npos;
+}
+
+size_t CCaseInsensitiveSearcher::FindHorspool(std::wstring_view haystack, size_t start) const
+{
+    size_t         m    = needle.size();
+    size_t         n    = haystack.size();
+    const wchar_t* text = haystack.data();
+    wchar_t        last = needle.back();
+    for (size_t pos = start; pos + m <= n;)
+    {
+        wchar_t c = table[text[pos + m - 1]];
+        if ((c == last) && Matches(text + pos))
+            return pos;
+        pos += skip[c & 0xFF];
+    }
+    return std::wstring_view::npos;
+}
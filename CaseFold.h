@@ -0,0 +1,84 @@
+// sktoolslib - common files for SK tools
+
+// Copyright (C) 2026 - Stefan Kueng
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+/**
+ * simple case folding of UTF16 code units.
+ * The table maps every char of the BMP to its lower case char as the
+ * invariant locale does. It is built once on first use; ASCII chars are
+ * folded without it.
+ */
+class CCaseFold
+{
+public:
+    static wchar_t Fold(wchar_t c)
+    {
+        if (c < 0x80)
+            return ((c >= 'A') && (c <= 'Z')) ? (c | 0x20) : c;
+        return GetTable()[c];
+    }
+
+    /// returns the table with the folded chars of all 0x10000 code units
+    static const wchar_t* GetTable();
+
+    /// returns true if a non ASCII char folds to the ASCII char \c c,
+    /// like the Kelvin sign does to 'k'
+    static bool HasNonAsciiFold(wchar_t c);
+
+    /// hash and compare strings with their case folded. Runs of ASCII chars are
+    /// handled eight bytes at a time without the table. Narrow strings only
+    /// have their ASCII letters folded.
+    static size_t Hash(std::wstring_view s);
+    static size_t Hash(std::string_view s);
+    static bool   Equal(std::wstring_view a, std::wstring_view b);
+    static bool   Equal(std::string_view a, std::string_view b);
+};
+
+/**
+ * finds a string case insensitively, using the folding of CCaseFold.
+ * The needle is prepared once in the constructor, so one searcher should be
+ * used to search many texts.
+ * If the first and the last char of the needle are ASCII chars, candidates are
+ * found with SSE2 by comparing these two chars for eight positions at once.
+ * Otherwise a Boyer-Moore-Horspool search is used.
+ */
+class CCaseInsensitiveSearcher
+{
+public:
+    CCaseInsensitiveSearcher(std::wstring_view needle);
+
+    /// returns the position of the first match at or after \c start, npos if none
+    size_t Find(std::wstring_view haystack, size_t start = 0) const;
+
+    size_t size() const { return needle.size(); }
+
+private:
+    bool   Matches(const wchar_t* text) const;
+    size_t FindSSE2(std::wstring_view haystack, size_t start) const;
+    size_t FindHorspool(std::wstring_view haystack, size_t start) const;
+
+    std::wstring   needle; // folded
+    const wchar_t* table;
+    size_t         skip[256];
+    bool           useSSE2;
+};
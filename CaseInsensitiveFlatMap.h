@@ -0,0 +1,274 @@
+// sktoolslib - common files for SK tools
+
+// Copyright (C) 2026 - Stefan Kueng
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+#pragma once
+
+#include "CaseFold.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+/**
+ * a hash map with case insensitive wide string keys, meant for caches keyed by
+ * paths or file extensions that are looked up very often.
+ * The entries are stored densely in a vector in insertion order (until an
+ * entry is erased, which moves the last entry into its place). An open
+ * addressing table with linear probing maps the hashes to the entries. Each
+ * table slot also holds part of the hash, so probing rarely has to compare a
+ * key. Keys are hashed and compared with CCaseFold; lookups take a
+ * std::wstring_view so they never create a temporary string.
+ * Iterating a non-const map yields pairs of references to the const key and
+ * the mutable value, so the key of an entry can't be changed.
+ * @code
+ * CCaseInsensitiveFlatMap<int> extensions;
+ * extensions[L".cpp"] = 1;
+ * if (auto* v = extensions.Find(L".CPP"))
+ *     ...
+ * @endcode
+ */
+template <typename T>
+class CCaseInsensitiveFlatMap
+{
+    using Entry = std::pair<std::wstring, T>;
+
+public:
+    using value_type     = Entry;
+    using const_iterator = typename std::vector<Entry>::const_iterator;
+
+    class iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = std::pair<const std::wstring&, T&>;
+        using difference_type   = std::ptrdiff_t;
+        using reference         = value_type;
+
+        // operator-> has to return something that holds the pair
+        struct pointer
+        {
+            value_type  ref;
+            value_type* operator->() { return &ref; }
+        };
+
+        iterator() = default;
+
+        reference operator*() const { return {it->first, it->second}; }
+        pointer   operator->() const { return {**this}; }
+        iterator& operator++()
+        {
+            ++it;
+            return *this;
+        }
+        iterator operator++(int)
+        {
+            iterator tmp = *this;
+            ++it;
+            return tmp;
+        }
+        bool operator==(const iterator& other) const { return it == other.it; }
+        bool operator!=(const iterator& other) const { return it != other.it; }
+
+        operator const_iterator() const { return it; }
+
+    private:
+        friend class CCaseInsensitiveFlatMap;
+        explicit iterator(typename std::vector<Entry>::iterator it)
+            : it(it)
+        {
+        }
+
+        typename std::vector<Entry>::iterator it;
+    };
+
+    CCaseInsensitiveFlatMap() = default;
+    explicit CCaseInsensitiveFlatMap(size_t expectedCount) { Reserve(expectedCount); }
+
+    size_t Size() const { return entries.size(); }
+    bool   Empty() const { return entries.empty(); }
+
+    void Clear()
+    {
+        entries.clear();
+        hashes.clear();
+        std::fill(slots.begin(), slots.end(), Slot());
+    }
+
+    /// makes room for \c count entries without rehashing
+    void Reserve(size_t count)
+    {
+        entries.reserve(count);
+        hashes.reserve(count);
+        size_t slotCount = minSlots;
+        while (slotCount * maxLoadNum < count * maxLoadDen)
+            slotCount *= 2;
+        if (slotCount > slots.size())
+            Rehash(slotCount);
+    }
+
+    /// returns the value for \c key, or nullptr if there is none
+    T* Find(std::wstring_view key)
+    {
+        auto index = FindEntry(key, CCaseFold::Hash(key));
+        return index == npos ? nullptr : &entries[index].second;
+    }
+    const T* Find(std::wstring_view key) const
+    {
+        auto index = FindEntry(key, CCaseFold::Hash(key));
+        return index == npos ? nullptr : &entries[index].second;
+    }
+    bool Contains(std::wstring_view key) const { return Find(key) != nullptr; }
+
+    /// inserts a value constructed from \c args if \c key is not in the map yet.
+    /// Returns the value for the key and whether it was inserted.
+    /// Like for std::vector, pointers to values are invalidated by inserting.
+    template <typename... Args>
+    std::pair<T*, bool> Emplace(std::wstring_view key, Args&&... args)
+    {
+        auto hash  = CCaseFold::Hash(key);
+        auto index = FindEntry(key, hash);
+        if (index != npos)
+            return {&entries[index].second, false};
+        if ((entries.size() + 1) * maxLoadDen > slots.size() * maxLoadNum)
+            Rehash(slots.empty() ? minSlots : slots.size() * 2);
+        entries.emplace_back(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+        hashes.push_back(hash);
+        PlaceEntry(hash, static_cast<uint32_t>(entries.size() - 1));
+        return {&entries.back().second, true};
+    }
+
+    T& operator[](std::wstring_view key) { return *Emplace(key).first; }
+
+    /// removes \c key from the map, returns false if it wasn't in the map
+    bool Erase(std::wstring_view key)
+    {
+        auto slot = FindSlot(key, CCaseFold::Hash(key));
+        if (slot == npos)
+            return false;
+        auto index = slots[slot].index;
+        RemoveSlot(slot);
+        auto last = static_cast<uint32_t>(entries.size() - 1);
+        if (index != last)
+        {
+            // fill the gap with the last entry so the entries stay dense
+            slots[FindSlotOfEntry(hashes[last], last)].index = index;
+            entries[index]                                 = std::move(entries[last]);
+            hashes[index]                                  = hashes[last];
+        }
+        entries.pop_back();
+        hashes.pop_back();
+        return true;
+    }
+
+    iterator       begin() { return iterator(entries.begin()); }
+    iterator       end() { return iterator(entries.end()); }
+    const_iterator begin() const { return entries.begin(); }
+    const_iterator end() const { return entries.end(); }
+
+private:
+    struct Slot
+    {
+        uint32_t tag   = 0;
+        uint32_t index = emptyIndex;
+    };
+
+    static constexpr uint32_t emptyIndex = 0xFFFFFFFF;
+    static constexpr size_t   npos       = static_cast<size_t>(-1);
+    static constexpr size_t   minSlots   = 16;
+    // linear probing degrades quickly when the table gets full, keep the load below 3/4
+    static constexpr size_t maxLoadNum = 3;
+    static constexpr size_t maxLoadDen = 4;
+
+    // the slot index uses the low bits of the hash, the tag the high bits
+    static uint32_t Tag(size_t hash) { return static_cast<uint32_t>(hash >> (sizeof(size_t) * 4)); }
+
+    size_t FindSlot(std::wstring_view key, size_t hash) const
+    {
+        if (entries.empty())
+            return npos;
+        auto mask = slots.size() - 1;
+        auto tag  = Tag(hash);
+        for (auto slot = hash & mask;; slot = (slot + 1) & mask)
+        {
+            const auto& s = slots[slot];
+            if (s.index == emptyIndex)
+                return npos;
+            if ((s.tag == tag) && (hashes[s.index] == hash) && CCaseFold::Equal(entries[s.index].first, key))
+                return slot;
+        }
+    }
+
+    size_t FindEntry(std::wstring_view key, size_t hash) const
+    {
+        auto slot = FindSlot(key, hash);
+        return slot == npos ? npos : slots[slot].index;
+    }
+
+    size_t FindSlotOfEntry(size_t hash, uint32_t index) const
+    {
+        auto mask = slots.size() - 1;
+        auto slot = hash & mask;
+        while (slots[slot].index != index)
+            slot = (slot + 1) & mask;
+        return slot;
+    }
+
+    void PlaceEntry(size_t hash, uint32_t index)
+    {
+        auto mask = slots.size() - 1;
+        auto slot = hash & mask;
+        while (slots[slot].index != emptyIndex)
+            slot = (slot + 1) & mask;
+        slots[slot] = {Tag(hash), index};
+    }
+
+    // backward shift deletion: move the following slots of the probe sequence
+    // into the gap so that lookups never need tombstones
+    void RemoveSlot(size_t slot)
+    {
+        auto mask = slots.size() - 1;
+        for (auto next = (slot + 1) & mask; slots[next].index != emptyIndex; next = (next + 1) & mask)
+        {
+            auto home = hashes[slots[next].index] & mask;
+            if (((next - home) & mask) >= ((next - slot) & mask))
+            {
+                slots[slot] = slots[next];
+                slot        = next;
+            }
+        }
+        slots[slot] = Slot();
+    }
+
+    void Rehash(size_t slotCount)
+    {
+        slots.assign(slotCount, Slot());
+        for (size_t i = 0; i < entries.size(); ++i)
+            PlaceEntry(hashes[i], static_cast<uint32_t>(i));
+    }
+
+    std::vector<Entry>  entries;
+    std::vector<size_t> hashes;
+    std::vector<Slot>   slots;
+};
@@ -1,6 +1,6 @@
 // sktoolslib - common files for SK tools
 
-// Copyright (C) 2013, 2020-2021 - Stefan Kueng
+// Copyright (C) 2013, 2020-2021, 2026 - Stefan Kueng
 
 // This program is free software; you can redistribute it and/or
 // modify it under the terms of the GNU General Public License
@@ -22,7 +22,6 @@
 #include "StringUtils.h"
 #include "UnicodeUtils.h"
 #include <fstream>
-#include <vector>
 #include <time.h>
 
 CCircularLog::CCircularLog()
@@ -63,7 +62,7 @@ bool CCircularLog::Init(const std::wstring& path, int maxlines)
         std::string line;
         while (std::getline(file, line))
         {
-            m_lines.push_back(CUnicodeUtils::StdGetUnicode(line));
+            UTF8ToWide(line, m_lines.emplace_back());
         };
         file.close();
     }
@@ -82,7 +81,10 @@ bool CCircularLog::AddLine(const std::wstring& line)
     wchar_t tmpBuf2[128] = {0};
     _wstrdate_s(tmpBuf2, 128);
 
-    m_lines.push_back(CStringUtils::Format(L"%s %s : %s", tmpBuf2, tmpBuf1, line.c_str()));
+    auto& entry = m_lines.emplace_back();
+    entry.reserve(wcslen(tmpBuf2) + wcslen(tmpBuf1) + 4 + line.size());
+    CStringUtils::AppendFormat(entry, L"%s %s : ", tmpBuf2, tmpBuf1);
+    entry += line;
     while (static_cast<int>(m_lines.size()) > m_maxLines)
         m_lines.pop_front();
     return true;
@@ -101,9 +103,14 @@ bool CCircularLog::Save()
         {
             return false;
         }
+        // convert all lines into the same buffer to avoid an allocation per line
+        std::string buffer;
         for (const auto& line : m_lines)
         {
-            file << CUnicodeUtils::StdGetUTF8(line) << std::endl;
+            buffer.clear();
+            WideToUTF8(line, buffer);
+            buffer += '\n';
+            file.write(buffer.data(), buffer.size());
         }
         file.close();
     }
@@ -117,19 +124,10 @@ bool CCircularLog::Save()
 void CCircularLog::operator()(LPCWSTR pszFormat, ...)
 {
     va_list marker;
-
-    // Initialize variable arguments
     va_start(marker, pszFormat);
-
-    // Get formatted string length adding one for the NULL
-    size_t len = _vscwprintf(pszFormat, marker) + 1;
-
-    // Create a char vector to hold the formatted string.
-    std::vector<wchar_t> buffer(len, L'\0');
-    _vsnwprintf_s(&buffer[0], buffer.size(), len, pszFormat, marker);
-
-    // Reset variable arguments
+    std::wstring line;
+    CStringUtils::AppendFormatV(line, pszFormat, marker);
     va_end(marker);
 
-    AddLine(&buffer[0]);
+    AddLine(line);
 }
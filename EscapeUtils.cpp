@@ -1,6 +1,6 @@
 ﻿// sktoolslib - common files for SK tools
 
-// Copyright (C) 2013, 2017, 2020-2021 - Stefan Kueng
+// Copyright (C) 2013, 2017, 2020-2021, 2026 - Stefan Kueng
 
 // This program is free software; you can redistribute it and/or
 // modify it under the terms of the GNU General Public License
@@ -186,7 +186,7 @@ std::string CEscapeUtils::EscapeString(const std::string& str)
         else
         {
             // char needs escaping
-            ret2 += CStringUtils::Format("%%%02X", static_cast<unsigned char>(c));
+            CStringUtils::AppendFormat(ret2, "%%%02X", static_cast<unsigned char>(c));
         }
     }
     std::string ret;
@@ -198,7 +198,7 @@ std::string CEscapeUtils::EscapeString(const std::string& str)
             if ((c == '%') && (DoesPercentNeedEscaping(ret2.substr(i).c_str())))
             {
                 // this percent sign needs escaping!
-                ret += CStringUtils::Format("%%%02X", static_cast<unsigned char>(c));
+                CStringUtils::AppendFormat(ret, "%%%02X", static_cast<unsigned char>(c));
             }
             else
             {
@@ -209,7 +209,7 @@ std::string CEscapeUtils::EscapeString(const std::string& str)
         else
         {
             // char needs escaping
-            ret += CStringUtils::Format("%%%02X", static_cast<unsigned char>(c));
+            CStringUtils::AppendFormat(ret, "%%%02X", static_cast<unsigned char>(c));
         }
     }
     return ret;
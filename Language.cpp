@@ -1,6 +1,6 @@
 ﻿// sktoolslib - common files for SK tools
 
-// Copyright (C) 2013, 2017-2018, 2020-2022 - Stefan Kueng
+// Copyright (C) 2013, 2017-2018, 2020-2022, 2026 - Stefan Kueng
 
 // This program is free software; you can redistribute it and/or
 // modify it under the terms of the GNU General Public License
@@ -19,6 +19,7 @@
 #include "stdafx.h"
 #include "Language.h"
 #include "StringUtils.h"
+#include "MultiReplacer.h"
 #include "UnicodeUtils.h"
 
 #include <Commctrl.h>
@@ -40,6 +41,15 @@ std::map<std::wstring, std::wstring> CLanguage::langmapBack;
 bool CLanguage::LoadFile(const std::wstring& path)
 {
     static std::wstring lastLangPath;
+    // unescapes the strings of the po file in one pass
+    static const CMultiReplacer unescaper = []() {
+        CMultiReplacer replacer;
+        replacer.Add(L"\\\"", L"\"");
+        replacer.Add(L"\\n", L"\n");
+        replacer.Add(L"\\r", L"\r");
+        replacer.Add(L"\\\\", L"\\");
+        return replacer;
+    }();
 
     // revert to original language, special: L1 -> L2 (fail -> L0) -> L0 (En)
     if (_wcsicmp(lastLangPath.c_str(), path.c_str()))
@@ -67,7 +77,10 @@ bool CLanguage::LoadFile(const std::wstring& path)
         return false;
     }
     auto                      line = std::make_unique<char[]>(2 * MAX_STRING_LENGTH);
+    // the entry strings are reused for the next entry, so converting
+    // the lines does not allocate once the strings are big enough
     std::vector<std::wstring> entry;
+    size_t                    entryCount = 0;
     do
     {
         file.getline(line.get(), 2 * MAX_STRING_LENGTH);
@@ -77,7 +90,7 @@ bool CLanguage::LoadFile(const std::wstring& path)
             std::wstring msgId;
             std::wstring msgStr;
             int          type = 0;
-            for (auto I = entry.begin(); I != entry.end(); ++I)
+            for (auto I = entry.begin(); I != entry.begin() + entryCount; ++I)
             {
                 if (wcsncmp(I->c_str(), L"# ", 2) == 0)
                 {
@@ -127,15 +140,9 @@ bool CLanguage::LoadFile(const std::wstring& path)
                     }
                 }
             }
-            entry.clear();
-            SearchReplace(msgId, L"\\\"", L"\"");
-            SearchReplace(msgId, L"\\n", L"\n");
-            SearchReplace(msgId, L"\\r", L"\r");
-            SearchReplace(msgId, L"\\\\", L"\\");
-            SearchReplace(msgStr, L"\\\"", L"\"");
-            SearchReplace(msgStr, L"\\n", L"\n");
-            SearchReplace(msgStr, L"\\r", L"\r");
-            SearchReplace(msgStr, L"\\\\", L"\\");
+            entryCount = 0;
+            unescaper.Replace(msgId);
+            unescaper.Replace(msgStr);
             if (!msgId.empty() && !msgStr.empty())
                 langmap[msgId] = msgStr;
             msgId.clear();
@@ -143,7 +150,11 @@ bool CLanguage::LoadFile(const std::wstring& path)
         }
         else
         {
-            entry.push_back(CUnicodeUtils::StdGetUnicode(line.get()));
+            if (entryCount == entry.size())
+                entry.emplace_back();
+            entry[entryCount].clear();
+            UTF8ToWide(std::string_view(line.get()), entry[entryCount]);
+            ++entryCount;
         }
     } while (file.gcount() > 0);
     file.close();
@@ -0,0 +1,158 @@
+// sktoolslib - common files for SK tools
+
+// Copyright (C) 2026 - Stefan Kueng
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+#include "stdafx.h"
+#include "LineIndex.h"
+#include <algorithm>
+
+CLineIndex::CLineIndex()
+    : count(0)
+{
+}
+
+bool CLineIndex::Build(const std::vector<size_t>& positions)
+{
+    Clear();
+    try
+    {
+        blocks.reserve((positions.size() + blockSize - 1) / blockSize);
+        size_t bitPos = 0;
+        for (size_t start = 0; start < positions.size(); start += blockSize)
+        {
+            size_t end = min(start + blockSize, positions.size());
+            // the positions are strictly increasing, so store the deltas minus one
+            size_t maxDelta = 0;
+            for (size_t i = start + 1; i < end; ++i)
+                maxDelta = max(maxDelta, positions[i] - positions[i - 1] - 1);
+            BYTE bits = 0;
+            while ((bits < 64) && ((maxDelta >> bits) != 0))
+                ++bits;
+            blocks.push_back({positions[start], bitPos, bits});
+            size_t blockBits = bits * (end - start - 1);
+            deltas.resize((bitPos + blockBits + 63) / 64 + 1);
+            for (size_t i = start + 1; (i < end) && bits; ++i)
+            {
+                UINT64 value = positions[i] - positions[i - 1] - 1;
+                size_t word  = bitPos / 64;
+                size_t shift = bitPos % 64;
+                deltas[word] |= value << shift;
+                if (shift + bits > 64)
+                    deltas[word + 1] |= value >> (64 - shift);
+                bitPos += bits;
+            }
+        }
+        deltas.shrink_to_fit();
+    }
+    catch (const std::exception&)
+    {
+        Clear();
+        return false;
+    }
+    count = positions.size();
+    return true;
+}
+
+void CLineIndex::Clear()
+{
+    blocks.clear();
+    blocks.shrink_to_fit();
+    deltas.clear();
+    deltas.shrink_to_fit();
+    count = 0;
+}
+
+UINT64 CLineIndex::ReadBits(size_t bitPos, BYTE bits) const
+{
+    size_t word  = bitPos / 64;
+    size_t shift = bitPos % 64;
+    UINT64 value = deltas[word] >> shift;
+    if (shift + bits > 64)
+        value |= deltas[word + 1] << (64 - shift);
+    if (bits < 64)
+        value &= (1ULL << bits) - 1;
+    return value;
+}
+
+size_t CLineIndex::operator[](size_t index) const
+{
+    const auto& block = blocks[index / blockSize];
+    size_t      pos   = block.base;
+    size_t      n     = index % blockSize;
+    if (block.bits == 0)
+        return pos + n;
+    for (size_t i = 0; i < n; ++i)
+        pos += static_cast<size_t>(ReadBits(block.bitPos + i * block.bits, block.bits)) + 1;
+    return pos;
+}
+
+size_t CLineIndex::LowerBound(size_t pos) const
+{
+    // find the first block that starts at or after pos: the result
+    // is either its first entry or inside the block before it
+    auto it = std::lower_bound(blocks.cbegin(), blocks.cend(), pos, [](const Block& block, size_t value) { return block.base < value; });
+    size_t blockIndex = std::distance(blocks.cbegin(), it);
+    if (blockIndex == 0)
+        return 0;
+    const auto& block = blocks[blockIndex - 1];
+    size_t      index = (blockIndex - 1) * blockSize;
+    size_t      end   = min(index + blockSize, count);
+    size_t      value = block.base;
+    for (size_t i = 0; index < end; ++i)
+    {
+        if (value >= pos)
+            return index;
+        ++index;
+        if (index < end)
+            value += (block.bits ? static_cast<size_t>(ReadBits(block.bitPos + i * block.bits, block.bits)) : 0) + 1;
+    }
+    return end;
+}
+
+size_t CLineIndex::Next(size_t index, size_t pos) const
+{
+    if (((index + 1) % blockSize) == 0)
+        return blocks[(index + 1) / blockSize].base;
+    const auto& block = blocks[index / blockSize];
+    if (block.bits == 0)
+        return pos + 1;
+    return pos + static_cast<size_t>(ReadBits(block.bitPos + (index % blockSize) * block.bits, block.bits)) + 1;
+}
+
+void CLineIndex::Expand(std::vector<size_t>& positions) const
+{
+    positions.clear();
+    positions.reserve(count);
+    for (size_t b = 0; b < blocks.size(); ++b)
+    {
+        const auto& block = blocks[b];
+        size_t      n     = min(blockSize, count - b * blockSize);
+        size_t      value = block.base;
+        positions.push_back(value);
+        for (size_t i = 1; i < n; ++i)
+        {
+            value += (block.bits ? static_cast<size_t>(ReadBits(block.bitPos + (i - 1) * block.bits, block.bits)) : 0) + 1;
+            positions.push_back(value);
+        }
+    }
+}
+
+size_t CLineIndex::GetMemorySize() const
+{
+    return blocks.capacity() * sizeof(Block) + deltas.capacity() * sizeof(UINT64);
+}
@@ -0,0 +1,76 @@
+// sktoolslib - common files for SK tools
+
+// Copyright (C) 2026 - Stefan Kueng
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+#pragma once
+
+#include <vector>
+
+/**
+ * stores a sorted list of line end positions in a compact form.
+ * The positions are stored in blocks of 64: every block has the absolute
+ * position of its first entry, the other entries are stored as deltas
+ * to their predecessor with just as many bits as the biggest delta
+ * in the block needs. For files with short lines, this needs about
+ * one byte per line instead of eight.
+ */
+class CLineIndex
+{
+public:
+    CLineIndex();
+
+    /// builds the index from a sorted list of positions
+    bool   Build(const std::vector<size_t>& positions);
+    void   Clear();
+
+    size_t size() const { return count; }
+    bool   empty() const { return count == 0; }
+
+    /// returns the position at \c index
+    size_t operator[](size_t index) const;
+
+    /// returns the index of the first position that is not smaller than \c pos,
+    /// size() if there is none
+    size_t LowerBound(size_t pos) const;
+
+    /// returns the position at \c index + 1, given the position \c pos at \c index.
+    /// Use this to walk the positions in order without decoding every block from the start.
+    size_t Next(size_t index, size_t pos) const;
+
+    /// fills \c positions with all the positions of the index
+    void   Expand(std::vector<size_t>& positions) const;
+
+    /// returns the number of bytes the index uses
+    size_t GetMemorySize() const;
+
+private:
+    static constexpr size_t blockSize = 64;
+
+    struct Block
+    {
+        size_t base;    ///< the first position in the block
+        size_t bitPos;  ///< start of the deltas in bits
+        BYTE   bits;    ///< number of bits per delta
+    };
+
+    UINT64 ReadBits(size_t bitPos, BYTE bits) const;
+
+    std::vector<Block>  blocks;
+    std::vector<UINT64> deltas;
+    size_t              count;
+};
@@ -0,0 +1,272 @@
+// sktoolslib - common files for SK tools
+
+// Copyright (C) 2026 - Stefan Kueng
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+#pragma once
+
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#    include <immintrin.h>
+#    ifdef _MSC_VER
+#        include <intrin.h>
+#    endif
+#    define LINESCANNER_SIMD
+#endif
+
+// gcc and clang only allow the AVX2 intrinsics in functions compiled for AVX2
+#if defined(LINESCANNER_SIMD) && !defined(_MSC_VER)
+#    define LINESCANNER_TARGET(isa) __attribute__((target(isa)))
+#else
+#    define LINESCANNER_TARGET(isa)
+#endif
+
+/**
+ * finds the line endings of a text with SSE2 or AVX2.
+ * Texts bigger than a few MB are split into chunks which are scanned in
+ * parallel. The class is header only and doesn't use the Windows API, so
+ * it builds with gcc and clang as well and can be benchmarked on Linux
+ * together with the POSIX backend of CMappedFile:
+ * @code
+ * CMappedFile      file;
+ * std::atomic_bool cancelled = false;
+ * std::vector<size_t> lineEnds;
+ * if (file.Open("big.txt") && CLineScanner::FindLineEnds(file, lineEnds, cancelled))
+ *     ...
+ * @endcode
+ */
+class CLineScanner
+{
+public:
+    /// fills \c positions with the position of the last character of every line:
+    /// for crlf lineendings that is the lf. The last line ends at \c length
+    /// if it has no lineending.
+    template <typename T>
+    static bool FindLineEnds(const T* pText, size_t length, T cr, T lf, std::vector<size_t>& positions, std::atomic_bool& bCancelled)
+    {
+        size_t chunks = (std::min)(static_cast<size_t>((std::max)(1u, std::thread::hardware_concurrency())), (length + chunkSize - 1) / chunkSize);
+        if (chunks > 1)
+        {
+            // scan big texts in parallel: since every chunk can look ahead into the
+            // next one, the chunk results can simply be appended to each other afterwards.
+            size_t                           partSize  = (length + chunks - 1) / chunks;
+            std::vector<std::vector<size_t>> chunkPositions(chunks);
+            std::atomic_bool                 failed    = false;
+            std::vector<std::thread>         workers;
+            auto                             scanChunk = [&](size_t chunk, std::vector<size_t>& chunkPos) {
+                try
+                {
+                    size_t chunkStart = chunk * partSize;
+                    ScanLineEnds(pText, chunkStart, (std::min)(length, chunkStart + partSize), length, cr, lf, chunkPos, bCancelled);
+                }
+                catch (const std::exception&)
+                {
+                    failed = true;
+                }
+            };
+            for (size_t chunk = 1; chunk < chunks; ++chunk)
+                workers.emplace_back([&, chunk]() { scanChunk(chunk, chunkPositions[chunk]); });
+            scanChunk(0, positions);
+            for (auto& worker : workers)
+                worker.join();
+            if (failed)
+                return false;
+
+            size_t count = positions.size();
+            for (const auto& chunkPos : chunkPositions)
+                count += chunkPos.size();
+            positions.reserve(count + 1);
+            for (auto& chunkPos : chunkPositions)
+            {
+                positions.insert(positions.end(), chunkPos.begin(), chunkPos.end());
+                chunkPos = std::vector<size_t>();
+            }
+        }
+        else
+            ScanLineEnds(pText, 0, length, length, cr, lf, positions, bCancelled);
+
+        // the last line has no lineending
+        if ((length == 0) || ((pText[length - 1] != cr) && (pText[length - 1] != lf)))
+            positions.push_back(length);
+        return true;
+    }
+
+    /// finds the line endings of the mapped bytes of a single byte or UTF8 file
+    static bool FindLineEnds(const CMappedFile& file, std::vector<size_t>& positions, std::atomic_bool& bCancelled)
+    {
+        if (!file.IsMapped())
+            return false;
+        return FindLineEnds<char>(reinterpret_cast<const char*>(file.GetData()), file.GetSize(), '\r', '\n', positions, bCancelled);
+    }
+
+    /// adds the line end at \c pos if the cr or lf there ends a line:
+    /// for crlf lineendings only the position of the lf is used.
+    template <typename T>
+    static void AddLineEnd(const T* pText, size_t pos, size_t length, T lf, std::vector<size_t>& positions)
+    {
+        if ((pText[pos] == lf) || (pos + 1 >= length) || (pText[pos + 1] != lf))
+            positions.push_back(pos);
+    }
+
+private:
+    // texts with more code units than this are split into chunks which get scanned in parallel
+    static constexpr size_t chunkSize = 4 * 1024 * 1024;
+    // number of code units scanned between checks for cancellation
+    static constexpr size_t sliceSize = 64 * 1024;
+
+    // fills \c positions with the line ends found between \c start and \c end.
+    // a cr at the end of the range looks ahead up to \c length, so the ranges
+    // can be scanned independently of each other.
+    template <typename T>
+    static void ScanLineEnds(const T* pText, size_t start, size_t end, size_t length, T cr, T lf, std::vector<size_t>& positions, std::atomic_bool& bCancelled)
+    {
+        for (size_t sliceStart = start; sliceStart < end && !bCancelled; sliceStart += sliceSize)
+        {
+            size_t sliceEnd = (std::min)(end, sliceStart + sliceSize);
+            size_t pos      = sliceStart;
+#ifdef LINESCANNER_SIMD
+            if (AVX2Supported())
+                pos = ScanLineEndsAVX2(pText, pos, sliceEnd, length, cr, lf, positions);
+            else if (SSE2Supported())
+                pos = ScanLineEndsSSE2(pText, pos, sliceEnd, length, cr, lf, positions);
+#endif
+            for (; pos < sliceEnd; ++pos)
+            {
+                if ((pText[pos] == cr) || (pText[pos] == lf))
+                    AddLineEnd(pText, pos, length, lf, positions);
+            }
+        }
+    }
+
+#ifdef LINESCANNER_SIMD
+    static bool SSE2Supported()
+    {
+#    if defined(_M_X64) || defined(__x86_64__)
+        return true;
+#    elif defined(_MSC_VER)
+        static const bool supported = []() {
+            int cpuInfo[4];
+            __cpuid(cpuInfo, 1);
+            return (cpuInfo[3] & (1 << 26)) != 0;
+        }();
+        return supported;
+#    else
+        static const bool supported = __builtin_cpu_supports("sse2");
+        return supported;
+#    endif
+    }
+
+    static bool AVX2Supported()
+    {
+#    ifdef _MSC_VER
+        static const bool supported = []() {
+            int cpuInfo[4];
+            __cpuid(cpuInfo, 0);
+            if (cpuInfo[0] < 7)
+                return false;
+            // the OS has to save the AVX registers
+            __cpuid(cpuInfo, 1);
+            if (((cpuInfo[2] & (1 << 27)) == 0) || ((_xgetbv(0) & 6) != 6))
+                return false;
+            __cpuidex(cpuInfo, 7, 0);
+            return (cpuInfo[1] & (1 << 5)) != 0;
+        }();
+#    else
+        static const bool supported = __builtin_cpu_supports("avx2");
+#    endif
+        return supported;
+    }
+
+    static unsigned long TrailingZeros(unsigned int mask)
+    {
+#    ifdef _MSC_VER
+        unsigned long bit = 0;
+        _BitScanForward(&bit, mask);
+        return bit;
+#    else
+        return static_cast<unsigned long>(__builtin_ctz(mask));
+#    endif
+    }
+
+    // adds the line ends for a block that starts at \c blockStart.
+    // \c mask is a byte mask from _mm_movemask_epi8, i.e. it has sizeof(T) bits set per cr or lf
+    template <typename T>
+    static void AddLineEnds(const T* pText, size_t blockStart, unsigned int mask, size_t length, T lf, std::vector<size_t>& positions)
+    {
+        constexpr unsigned int unitMask = (1u << sizeof(T)) - 1;
+        while (mask)
+        {
+            unsigned long bit = TrailingZeros(mask);
+            AddLineEnd(pText, blockStart + bit / sizeof(T), length, lf, positions);
+            mask &= ~(unitMask << bit);
+        }
+    }
+
+    template <typename T>
+    LINESCANNER_TARGET("sse2")
+    static size_t ScanLineEndsSSE2(const T* pText, size_t start, size_t end, size_t length, T cr, T lf, std::vector<size_t>& positions)
+    {
+        constexpr size_t unitsPerBlock = sizeof(__m128i) / sizeof(T);
+        const __m128i    crMask        = (sizeof(T) == 1) ? _mm_set1_epi8(static_cast<char>(cr)) : _mm_set1_epi16(static_cast<short>(cr));
+        const __m128i    lfMask        = (sizeof(T) == 1) ? _mm_set1_epi8(static_cast<char>(lf)) : _mm_set1_epi16(static_cast<short>(lf));
+        size_t           pos           = start;
+        for (; pos + unitsPerBlock <= end; pos += unitsPerBlock)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pText + pos));
+            __m128i found;
+            if constexpr (sizeof(T) == 1)
+                found = _mm_or_si128(_mm_cmpeq_epi8(chunk, crMask), _mm_cmpeq_epi8(chunk, lfMask));
+            else
+                found = _mm_or_si128(_mm_cmpeq_epi16(chunk, crMask), _mm_cmpeq_epi16(chunk, lfMask));
+            unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(found));
+            if (mask)
+                AddLineEnds(pText, pos, mask, length, lf, positions);
+        }
+        return pos;
+    }
+
+    template <typename T>
+    LINESCANNER_TARGET("avx2")
+    static size_t ScanLineEndsAVX2(const T* pText, size_t start, size_t end, size_t length, T cr, T lf, std::vector<size_t>& positions)
+    {
+        constexpr size_t unitsPerBlock = sizeof(__m256i) / sizeof(T);
+        const __m256i    crMask        = (sizeof(T) == 1) ? _mm256_set1_epi8(static_cast<char>(cr)) : _mm256_set1_epi16(static_cast<short>(cr));
+        const __m256i    lfMask        = (sizeof(T) == 1) ? _mm256_set1_epi8(static_cast<char>(lf)) : _mm256_set1_epi16(static_cast<short>(lf));
+        size_t           pos           = start;
+        for (; pos + unitsPerBlock <= end; pos += unitsPerBlock)
+        {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pText + pos));
+            __m256i found;
+            if constexpr (sizeof(T) == 1)
+                found = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, crMask), _mm256_cmpeq_epi8(chunk, lfMask));
+            else
+                found = _mm256_or_si256(_mm256_cmpeq_epi16(chunk, crMask), _mm256_cmpeq_epi16(chunk, lfMask));
+            unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(found));
+            if (mask)
+                AddLineEnds(pText, pos, mask, length, lf, positions);
+        }
+        return pos;
+    }
+#endif
+};
@@ -0,0 +1,130 @@
+// sktoolslib - common files for SK tools
+
+// Copyright (C) 2026 - Stefan Kueng
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+#pragma once
+
+#include <cstddef>
+
+#ifndef _WIN32
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+/**
+ * a read-only memory mapping of a whole file.
+ * On Windows the file mapping API is used, on other platforms POSIX mmap.
+ * Code that only works on the mapped bytes, like CLineScanner, can so be
+ * built and benchmarked on Linux as well.
+ * The class is header only so it doesn't need the Windows specific
+ * precompiled header.
+ */
+class CMappedFile
+{
+public:
+    CMappedFile() = default;
+    ~CMappedFile() { Close(); }
+
+    CMappedFile(const CMappedFile&)            = delete;
+    CMappedFile& operator=(const CMappedFile&) = delete;
+
+#ifdef _WIN32
+    /// maps the file \c hFile which must be opened for reading.
+    /// The handle can be closed once the file is mapped.
+    bool Map(HANDLE hFile)
+    {
+        Close();
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(hFile, &fileSize) || (fileSize.QuadPart <= 0) || (static_cast<unsigned long long>(fileSize.QuadPart) > static_cast<size_t>(-1)))
+            return false;
+        HANDLE hMapping = CreateFileMapping(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (hMapping == nullptr)
+            return false;
+        // the view keeps the mapping alive
+        void* view = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+        ::CloseHandle(hMapping);
+        if (view == nullptr)
+            return false;
+        data = static_cast<const unsigned char*>(view);
+        size = static_cast<size_t>(fileSize.QuadPart);
+        return true;
+    }
+
+    bool Open(const wchar_t* path)
+    {
+        HANDLE hFile = CreateFile(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (hFile == INVALID_HANDLE_VALUE)
+            return false;
+        bool ret = Map(hFile);
+        ::CloseHandle(hFile);
+        return ret;
+    }
+
+    void Close()
+    {
+        if (data)
+            UnmapViewOfFile(data);
+        data = nullptr;
+        size = 0;
+    }
+#else
+    /// maps the file \c fd which must be opened for reading.
+    /// The descriptor can be closed once the file is mapped.
+    bool Map(int fd)
+    {
+        Close();
+        struct stat st;
+        if ((fstat(fd, &st) != 0) || (st.st_size <= 0) || (static_cast<unsigned long long>(st.st_size) > static_cast<size_t>(-1)))
+            return false;
+        void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view == MAP_FAILED)
+            return false;
+        data = static_cast<const unsigned char*>(view);
+        size = static_cast<size_t>(st.st_size);
+        return true;
+    }
+
+    bool Open(const char* path)
+    {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        bool ret = Map(fd);
+        close(fd);
+        return ret;
+    }
+
+    void Close()
+    {
+        if (data)
+            munmap(const_cast<unsigned char*>(data), size);
+        data = nullptr;
+        size = 0;
+    }
+#endif
+
+    bool                 IsMapped() const { return data != nullptr; }
+    const unsigned char* GetData() const { return data; }
+    size_t               GetSize() const { return size; }
+
+private:
+    const unsigned char* data = nullptr;
+    size_t               size = 0;
+};
@@ -0,0 +1,170 @@
+// sktoolslib - common files for SK tools
+
+// Copyright (C) 2026 - Stefan Kueng
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+#include "stdafx.h"
+#include "MultiReplacer.h"
+
+#include <queue>
+
+CMultiReplacer::CMultiReplacer()
+{
+    Clear();
+}
+
+void CMultiReplacer::Clear()
+{
+    nodes.assign(1, Node());
+    replacements.clear();
+    firstChars.reset();
+}
+
+void CMultiReplacer::Add(std::wstring_view search, std::wstring_view replace)
+{
+    if (search.empty())
+        return;
+    int node = 0;
+    for (wchar_t c : search)
+    {
+        int child = Child(node, c);
+        if (child == 0)
+        {
+            child = static_cast<int>(nodes.size());
+            nodes.emplace_back().depth = nodes[node].depth + 1;
+            nodes[node].edges.emplace_back(c, child);
+        }
+        node = child;
+    }
+    if (nodes[node].pattern >= 0)
+    {
+        replacements[nodes[node].pattern].second = replace;
+        return;
+    }
+    nodes[node].pattern = static_cast<int>(replacements.size());
+    replacements.emplace_back(search, replace);
+    firstChars.set(static_cast<unsigned short>(search.front()));
+    BuildLinks();
+}
+
+int CMultiReplacer::Child(int node, wchar_t c) const
+{
+    for (const auto& [ch, child] : nodes[node].edges)
+    {
+        if (ch == c)
+            return child;
+    }
+    return 0;
+}
+
+int CMultiReplacer::Next(int node, wchar_t c) const
+{
+    for (;;)
+    {
+        int child = Child(node, c);
+        if ((child != 0) || (node == 0))
+            return child;
+        node = nodes[node].fail;
+    }
+}
+
+void CMultiReplacer::BuildLinks()
+{
+    // breadth first, so the fail link of a node is always done before its children
+    std::queue<int> todo;
+    for (const auto& edge : nodes[0].edges)
+    {
+        nodes[edge.second].fail    = 0;
+        nodes[edge.second].outLink = 0;
+        todo.push(edge.second);
+    }
+    while (!todo.empty())
+    {
+        int node = todo.front();
+        todo.pop();
+        for (const auto& [c, child] : nodes[node].edges)
+        {
+            int fail             = Next(nodes[node].fail, c);
+            nodes[child].fail    = fail;
+            nodes[child].outLink = (nodes[fail].pattern >= 0) ? fail : nodes[fail].outLink;
+            todo.push(child);
+        }
+    }
+}
+
+bool CMultiReplacer::FindNext(std::wstring_view text, size_t pos, size_t& matchStart, int& pattern) const
+{
+    bool   found     = false;
+    size_t bestStart = 0;
+    size_t bestLen   = 0;
+    int    node      = 0;
+    for (size_t i = pos; i < text.size(); ++i)
+    {
+        // a match that starts earlier or at the same position has to
+        // continue the current path, which starts at i - depth
+        if (found && (i - nodes[node].depth > bestStart))
+            break;
+        wchar_t c = text[i];
+        if ((node == 0) && !firstChars.test(static_cast<unsigned short>(c)))
+            continue;
+        node = Next(node, c);
+        for (int n = (nodes[node].pattern >= 0) ? node : nodes[node].outLink; n != 0; n = nodes[n].outLink)
+        {
+            size_t len   = nodes[n].depth;
+            size_t start = i + 1 - len;
+            if (!found || (start < bestStart) || ((start == bestStart) && (len > bestLen)))
+            {
+                found     = true;
+                bestStart = start;
+                bestLen   = len;
+                pattern   = nodes[n].pattern;
+            }
+        }
+    }
+    matchStart = bestStart;
+    return found;
+}
+
+size_t CMultiReplacer::Replace(std::wstring_view text, std::wstring& dst) const
+{
+    size_t count      = 0;
+    size_t pos        = 0;
+    size_t matchStart = 0;
+    int    pattern    = -1;
+    while (FindNext(text, pos, matchStart, pattern))
+    {
+        if (count++ == 0)
+            dst.reserve(dst.size() + text.size());
+        dst.append(text.substr(pos, matchStart - pos));
+        dst.append(replacements[pattern].second);
+        pos = matchStart + replacements[pattern].first.size();
+    }
+    dst.append(text.substr(pos));
+    return count;
+}
+
+size_t CMultiReplacer::Replace(std::wstring& text) const
+{
+    size_t matchStart = 0;
+    int    pattern    = -1;
+    if (!FindNext(text, 0, matchStart, pattern))
+        return 0;
+    std::wstring result;
+    size_t       count = Replace(text, result);
+    text               = std::move(result);
+    return count;
+}
@@ -0,0 +1,69 @@
+// sktoolslib - common files for SK tools
+
+// Copyright (C) 2026 - Stefan Kueng
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+#pragma once
+
+#include <bitset>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * replaces several strings in one pass over a text.
+ * The search strings are stored in an Aho-Corasick automaton, so the text is
+ * scanned only once no matter how many strings are replaced.
+ * Matches don't overlap: the match that starts first wins, and of the matches
+ * that start at the same position the longest one. So with the replacements
+ * "\\\\" -> "\\" and "\\n" -> "\n" the text "\\\\n" becomes "\\n".
+ */
+class CMultiReplacer
+{
+public:
+    CMultiReplacer();
+
+    /// adds a replacement. Adding a search string twice changes its replacement.
+    void   Add(std::wstring_view search, std::wstring_view replace);
+    void   Clear();
+
+    /// appends the text with all replacements done to \c dst.
+    /// \return the number of replacements
+    size_t Replace(std::wstring_view text, std::wstring& dst) const;
+    /// replaces in \c text. A text without matches is not modified.
+    /// \return the number of replacements
+    size_t Replace(std::wstring& text) const;
+
+private:
+    struct Node
+    {
+        std::vector<std::pair<wchar_t, int>> edges;
+        int                                  fail    = 0;
+        int                                  outLink = 0;  // next node on the fail chain that ends a search string
+        int                                  pattern = -1; // index of the search string that ends here
+        size_t                               depth   = 0;
+    };
+
+    int    Child(int node, wchar_t c) const;
+    int    Next(int node, wchar_t c) const;
+    void   BuildLinks();
+    bool   FindNext(std::wstring_view text, size_t pos, size_t& matchStart, int& pattern) const;
+
+    std::vector<Node>                                  nodes;
+    std::vector<std::pair<std::wstring, std::wstring>> replacements;
+    std::bitset<0x10000>                               firstChars;
+};
@@ -0,0 +1,477 @@
+// sktoolslib - common files for SK tools
+
+// Copyright (C) 2026 - Stefan Kueng
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+#include "stdafx.h"
+#include "RegexPrefilter.h"
+#include "UnicodeUtils.h"
+#include "Utf8ToWideIterator.h"
+
+#include <algorithm>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#    include <emmintrin.h>
+#    include <intrin.h>
+#endif
+
+static BOOL sse2Supported = ::IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE);
+
+namespace
+{
+constexpr size_t npos = static_cast<size_t>(-1);
+
+bool IsLineBreak(char c)
+{
+    return (c == '\r') || (c == '\n');
+}
+
+bool IsAsciiAlpha(char c)
+{
+    return ((c | 0x20) >= 'a') && ((c | 0x20) <= 'z');
+}
+
+constexpr int classEscape      = -1; ///< a class escape like \w that can't match a line break
+constexpr int lineBreakEscape  = -2; ///< an escape or class that might match a line break
+
+// returns true if \c c is an escape that might match a cr or lf
+bool IsLineBreakEscape(wchar_t c)
+{
+    return wcschr(L"sWDnrxuc0", c) != nullptr;
+}
+
+// reads one char of a bracket expression at \c i and moves \c i past it.
+// Returns the char, classEscape or lineBreakEscape.
+int ReadClassAtom(const std::wstring& pattern, size_t& i)
+{
+    wchar_t c = pattern[i++];
+    if ((c == '[') && (i < pattern.size()) && wcschr(L":.=", pattern[i]))
+        return lineBreakEscape; // [:space:] and friends
+    if ((c != '\\') || (i >= pattern.size()))
+        return c;
+    c = pattern[i++];
+    if (IsLineBreakEscape(c))
+        return lineBreakEscape;
+    switch (c)
+    {
+        case 't':
+            return '\t';
+        case 'v':
+            return '\v';
+        case 'f':
+            return '\f';
+        case 'b':
+            return '\b';
+        case 'w':
+        case 'd':
+        case 'S':
+            return classEscape;
+        default:
+            return c;
+    }
+}
+
+// returns true if the bracket expression that starts at \c i might match a
+// cr or lf, either directly, through an escape or with a range like [\t-z]
+// whose bounds enclose them. Moves \c i to the closing ']'.
+bool ClassCanMatchLineBreak(const std::wstring& pattern, size_t& i)
+{
+    ++i;
+    if ((i < pattern.size()) && (pattern[i] == '^'))
+        return true;
+    bool first = true;
+    while ((i < pattern.size()) && ((pattern[i] != ']') || first))
+    {
+        first    = false;
+        int low  = ReadClassAtom(pattern, i);
+        int high = low;
+        if ((i + 1 < pattern.size()) && (pattern[i] == '-') && (pattern[i + 1] != ']'))
+        {
+            ++i;
+            high = ReadClassAtom(pattern, i);
+        }
+        if ((low == lineBreakEscape) || (high == lineBreakEscape))
+            return true;
+        if ((low >= 0) && (high >= 0) && (((low <= '\n') && (high >= '\n')) || ((low <= '\r') && (high >= '\r'))))
+            return true;
+    }
+    return false;
+}
+
+// returns true if the pattern might match a cr or lf. This is conservative:
+// all escapes and classes that include line breaks are treated as such.
+bool CanMatchLineBreak(const std::wstring& pattern)
+{
+    for (size_t i = 0; i < pattern.size(); ++i)
+    {
+        wchar_t c = pattern[i];
+        if ((c == '\r') || (c == '\n'))
+            return true;
+        if (c == '[')
+        {
+            if (ClassCanMatchLineBreak(pattern, i))
+                return true;
+        }
+        else if ((c == '\\') && (i + 1 < pattern.size()))
+        {
+            ++i;
+            if (IsLineBreakEscape(pattern[i]))
+                return true;
+        }
+    }
+    return false;
+}
+
+// splits the pattern at the top level '|'
+std::vector<std::wstring> SplitAlternatives(const std::wstring& pattern)
+{
+    std::vector<std::wstring> alternatives;
+    int                       depth   = 0;
+    bool                      inClass = false;
+    size_t                    start   = 0;
+    for (size_t i = 0; i < pattern.size(); ++i)
+    {
+        wchar_t c = pattern[i];
+        if (c == '\\')
+            ++i;
+        else if (inClass)
+            inClass = (c != ']');
+        else if (c == '[')
+            inClass = true;
+        else if (c == '(')
+            ++depth;
+        else if (c == ')')
+            --depth;
+        else if ((c == '|') && (depth == 0))
+        {
+            alternatives.push_back(pattern.substr(start, i - start));
+            start = i + 1;
+        }
+    }
+    alternatives.push_back(pattern.substr(start));
+    return alternatives;
+}
+
+// skips the class or group that starts at \c i
+size_t SkipClass(const std::wstring& branch, size_t i)
+{
+    ++i;
+    if ((i < branch.size()) && (branch[i] == '^'))
+        ++i;
+    if ((i < branch.size()) && (branch[i] == ']'))
+        ++i;
+    while ((i < branch.size()) && (branch[i] != ']'))
+        i += (branch[i] == '\\') ? 2 : 1;
+    return i + 1;
+}
+
+size_t SkipGroup(const std::wstring& branch, size_t i)
+{
+    int depth = 0;
+    while (i < branch.size())
+    {
+        wchar_t c = branch[i];
+        if (c == '\\')
+            i += 2;
+        else if (c == '[')
+            i = SkipClass(branch, i);
+        else
+        {
+            ++i;
+            if (c == '(')
+                ++depth;
+            else if ((c == ')') && (--depth == 0))
+                break;
+        }
+    }
+    return i;
+}
+
+// returns the longest run of chars that every match of the branch contains
+std::wstring RequiredLiteral(const std::wstring& branch)
+{
+    std::wstring best;
+    std::wstring current;
+    auto         endRun = [&]() {
+        if (current.size() > best.size())
+            best = current;
+        current.clear();
+    };
+    size_t i = 0;
+    while (i < branch.size())
+    {
+        wchar_t c         = branch[i];
+        bool    isLiteral = false;
+        if (c == '\\')
+        {
+            if (i + 1 >= branch.size())
+                return {};
+            wchar_t e = branch[i + 1];
+            i += 2;
+            if (wcschr(L"^$\\.*+?()[]{}|/-", e))
+            {
+                isLiteral = true;
+                c         = e;
+            }
+            else
+            {
+                // classes, assertions and back references
+                while ((e >= '1') && (e <= '9') && (i < branch.size()) && iswdigit(branch[i]))
+                    ++i;
+            }
+        }
+        else if (c == '[')
+            i = SkipClass(branch, i);
+        else if (c == '(')
+            i = SkipGroup(branch, i);
+        else if ((c == '.') || (c == '^') || (c == '$'))
+            ++i;
+        else if (wcschr(L"*+?{})|", c))
+            return {}; // not a valid regex
+        else
+        {
+            isLiteral = true;
+            ++i;
+        }
+
+        bool optional = false;
+        bool repeated = false;
+        if (i < branch.size())
+        {
+            wchar_t q = branch[i];
+            if ((q == '*') || (q == '?'))
+            {
+                optional = true;
+                ++i;
+            }
+            else if (q == '+')
+            {
+                repeated = true;
+                ++i;
+            }
+            else if (q == '{')
+            {
+                optional = (i + 1 < branch.size()) && (branch[i + 1] == '0');
+                repeated = !optional;
+                while ((i < branch.size()) && (branch[i] != '}'))
+                    ++i;
+                ++i;
+            }
+            if ((optional || repeated) && (i < branch.size()) && (branch[i] == '?'))
+                ++i; // non greedy
+        }
+        if (isLiteral && !optional)
+        {
+            current += c;
+            if (repeated)
+                endRun();
+        }
+        else
+            endRun();
+    }
+    endRun();
+    return best;
+}
+
+bool LiteralMatches(const char* text, const std::string& literal, bool icase)
+{
+    if (!icase)
+        return memcmp(text, literal.c_str(), literal.size()) == 0;
+    for (size_t i = 0; i < literal.size(); ++i)
+    {
+        if ((text[i] != literal[i]) && (!IsAsciiAlpha(literal[i]) || ((text[i] | 0x20) != (literal[i] | 0x20))))
+            return false;
+    }
+    return true;
+}
+
+// finds the literal with SSE2 by comparing its first and last byte
+// for 16 positions at once, only the candidates are compared fully
+size_t FindLiteral(const char* text, size_t len, size_t start, const std::string& literal, bool icase)
+{
+    size_t m = literal.size();
+    if ((m == 0) || (len < m))
+        return npos;
+    size_t i = start;
+#if defined(_M_IX86) || defined(_M_X64)
+    if (sse2Supported)
+    {
+        char          first     = literal[0];
+        char          last      = literal[m - 1];
+        bool          foldFirst = icase && IsAsciiAlpha(first);
+        bool          foldLast  = icase && IsAsciiAlpha(last);
+        const __m128i firstMask = _mm_set1_epi8(foldFirst ? (first | 0x20) : first);
+        const __m128i lastMask  = _mm_set1_epi8(foldLast ? (last | 0x20) : last);
+        const __m128i firstFold = _mm_set1_epi8(foldFirst ? 0x20 : 0);
+        const __m128i lastFold  = _mm_set1_epi8(foldLast ? 0x20 : 0);
+        for (; i + m - 1 + 16 <= len; i += 16)
+        {
+            __m128i firstBytes = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i)), firstFold);
+            __m128i lastBytes  = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + m - 1)), lastFold);
+            int     mask       = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(firstBytes, firstMask), _mm_cmpeq_epi8(lastBytes, lastMask)));
+            unsigned long bit  = 0;
+            while (_BitScanForward(&bit, mask))
+            {
+                if (LiteralMatches(text + i + bit, literal, icase))
+                    return i + bit;
+                mask &= mask - 1;
+            }
+        }
+    }
+#endif
+    for (; i + m <= len; ++i)
+    {
+        if (LiteralMatches(text + i, literal, icase))
+            return i;
+    }
+    return npos;
+}
+} // namespace
+
+CRegexPrefilter::CRegexPrefilter()
+    : icase(false)
+    , cacheText(nullptr)
+    , cacheLen(0)
+    , cacheStart(0)
+{
+}
+
+bool CRegexPrefilter::Init(const std::wstring& pattern, std::regex_constants::syntax_option_type flags)
+{
+    literals.clear();
+    ResetCache();
+    try
+    {
+        regex.assign(pattern, flags);
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+    icase = (flags & std::regex_constants::icase) != 0;
+
+    constexpr auto otherGrammars = std::regex_constants::basic | std::regex_constants::extended | std::regex_constants::awk |
+                                   std::regex_constants::grep | std::regex_constants::egrep;
+    if (((flags & otherGrammars) != 0) || CanMatchLineBreak(pattern))
+        return true;
+
+    std::vector<std::string> required;
+    for (const auto& alternative : SplitAlternatives(pattern))
+    {
+        std::wstring literal = RequiredLiteral(alternative);
+        if (literal.empty())
+            return true;
+        if (icase && std::any_of(literal.begin(), literal.end(), [](wchar_t c) { return c >= 0x80; }))
+            return true;
+        required.push_back(WideToUTF8(literal, false));
+    }
+    std::sort(required.begin(), required.end());
+    required.erase(std::unique(required.begin(), required.end()), required.end());
+    literals = std::move(required);
+    return true;
+}
+
+bool CRegexPrefilter::Search(const char* text, size_t len, size_t start, size_t& matchStart, size_t& matchEnd)
+{
+    if (literals.empty())
+        return RegexSearch(text, len, start, len, matchStart, matchEnd);
+
+    // the same address and length don't mean the same text: buffers get
+    // reused, so every new pass over a text starts without cached positions
+    if ((start == 0) || (start < cacheStart))
+        ResetCache();
+    cacheStart = start;
+
+    size_t pos = start;
+    while (pos < len)
+    {
+        size_t literalLen = 0;
+        size_t candidate  = NextCandidate(text, len, pos, literalLen);
+        if (candidate == npos)
+            return false;
+        // a match can't span lines: only search the line of the literal.
+        // The line break is part of the searched range so that '$' sees
+        // the same chars as in a search of the whole text.
+        size_t lineStart = candidate;
+        while ((lineStart > pos) && !IsLineBreak(text[lineStart - 1]))
+            --lineStart;
+        size_t lineEnd = candidate + literalLen;
+        while ((lineEnd < len) && !IsLineBreak(text[lineEnd]))
+            ++lineEnd;
+        if ((lineEnd < len) && (text[lineEnd] == '\r'))
+            ++lineEnd;
+        if ((lineEnd < len) && (text[lineEnd] == '\n'))
+            ++lineEnd;
+        if (RegexSearch(text, len, lineStart, lineEnd, matchStart, matchEnd))
+            return true;
+        pos = lineEnd;
+    }
+    return false;
+}
+
+bool CRegexPrefilter::RegexSearch(const char* text, size_t len, size_t start, size_t end, size_t& matchStart, size_t& matchEnd) const
+{
+    if (start > end)
+        return false;
+    auto flags = std::regex_constants::match_default;
+    if (start > 0)
+        flags |= std::regex_constants::match_prev_avail;
+    if (end < len)
+        flags |= std::regex_constants::match_not_eol;
+    const auto*                                 pText = reinterpret_cast<const unsigned char*>(text);
+    std::match_results<Utf8ToWideBlockIterator> match;
+    try
+    {
+        // the iterators use the whole text so that the char before start is available
+        if (!std::regex_search(Utf8ToWideBlockIterator(pText, len, start), Utf8ToWideBlockIterator(pText, len, end), match, regex, flags))
+            return false;
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+    matchStart = match[0].first.CurrentPos();
+    matchEnd   = match[0].second.CurrentPos();
+    return true;
+}
+
+size_t CRegexPrefilter::NextCandidate(const char* text, size_t len, size_t pos, size_t& literalLen)
+{
+    if ((cacheText != text) || (cacheLen != len))
+    {
+        cacheText = text;
+        cacheLen  = len;
+        cacheFrom.assign(literals.size(), npos);
+        cacheFound.assign(literals.size(), npos);
+    }
+    size_t candidate = npos;
+    for (size_t i = 0; i < literals.size(); ++i)
+    {
+        // the position from an earlier search is still valid if it wasn't passed yet
+        if ((cacheFrom[i] > pos) || ((cacheFound[i] != npos) && (cacheFound[i] < pos)))
+        {
+            cacheFrom[i]  = pos;
+            cacheFound[i] = FindLiteral(text, len, pos, literals[i], icase);
+        }
+        if (cacheFound[i] < candidate)
+        {
+            candidate  = cacheFound[i];
+            literalLen = literals[i].size();
+        }
+    }
+    return candidate;
+}
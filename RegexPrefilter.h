@@ -0,0 +1,81 @@
+// sktoolslib - common files for SK tools
+
+// Copyright (C) 2026 - Stefan Kueng
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+#pragma once
+
+#include <regex>
+#include <string>
+#include <vector>
+
+/**
+ * speeds up searching a std::wregex in UTF8 text.
+ * Init() extracts the literals from the pattern that every match has to
+ * contain, one for every top level alternative. Search() then scans the
+ * raw UTF8 bytes for these literals with SSE2 and only runs the regex on
+ * the lines that contain one of them.
+ * The prefilter is only used for ECMAScript patterns that can't match a
+ * line break, since a match then can't span lines; all other patterns
+ * are searched in the whole text.
+ * For case insensitive patterns only ASCII literals are used, compared
+ * with ASCII case folding.
+ */
+class CRegexPrefilter
+{
+public:
+    CRegexPrefilter();
+
+    /// compiles the regex and extracts the literals.
+    /// \return false if the pattern is not a valid regex
+    bool        Init(const std::wstring& pattern, std::regex_constants::syntax_option_type flags = std::regex_constants::ECMAScript);
+
+    /// returns true if the lines are filtered by literals
+    bool        IsFiltered() const { return !literals.empty(); }
+
+    /// returns the UTF8 literals, at least one of which is part of every match
+    const std::vector<std::string>& GetLiterals() const { return literals; }
+
+    /// searches the regex in the UTF8 text, starting at the byte offset \c start.
+    /// The text before \c start is used for anchors and word boundaries.
+    /// Call this with increasing \c start values to find all matches of a
+    /// text: the positions of the literals are remembered between the calls.
+    /// A \c start of 0 or lower than the one of the last call begins a new
+    /// pass and forgets them.
+    /// \return false if there is no match
+    bool        Search(const char* text, size_t len, size_t start, size_t& matchStart, size_t& matchEnd);
+
+    /// forgets the remembered positions of the literals. Call this if the
+    /// text was changed in place, or if a different text is searched at
+    /// the same address with a \c start that does not begin a new pass.
+    void        ResetCache() { cacheText = nullptr; }
+
+private:
+    bool        RegexSearch(const char* text, size_t len, size_t start, size_t end, size_t& matchStart, size_t& matchEnd) const;
+    size_t      NextCandidate(const char* text, size_t len, size_t pos, size_t& literalLen);
+
+    std::wregex              regex;
+    bool                     icase;
+    std::vector<std::string> literals;
+
+    // positions of the next occurrence of each literal in the last searched text
+    const char*              cacheText;
+    size_t                   cacheLen;
+    size_t                   cacheStart; ///< the start of the last search
+    std::vector<size_t>      cacheFrom;
+    std::vector<size_t>      cacheFound;
+};
@@ -0,0 +1,60 @@
+// sktoolslib - common files for SK tools
+
+// Copyright (C) 2026 - Stefan Kueng
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+#pragma once
+
+/**
+ * converts text in a single byte code page to UTF16 and back without
+ * the OS converters, so the result is the same on every system.
+ * Runs of ASCII chars are converted 16 at a time with SSE2, all other
+ * bytes are looked up in a table.
+ * The built-in code pages are windows-1252, ISO-8859-1 (28591),
+ * ISO-8859-15 (28605) and OEM-US (437).
+ */
+class CSingleByteCodePage
+{
+public:
+    /// returns the converter for \c codePage, nullptr if it is not built in.
+    /// CP_ACP is not resolved: the ANSI code page can only be selected explicitly.
+    static const CSingleByteCodePage* Get(UINT codePage);
+
+    UINT   GetCodePage() const { return codePage; }
+
+    /// converts \c len bytes to UTF16. \c dst must have room for \c len chars.
+    void   ToWide(const char* src, size_t len, wchar_t* dst) const;
+
+    /// converts \c len UTF16 chars. \c dst must have room for \c len bytes.
+    /// Chars that the code page doesn't have are replaced with \c defaultChar,
+    /// a surrogate pair is replaced with one \c defaultChar.
+    /// \return the number of bytes written
+    size_t FromWide(const wchar_t* src, size_t len, char* dst, char defaultChar = '?', bool* defaultCharUsed = nullptr) const;
+
+private:
+    CSingleByteCodePage(UINT codePage, const wchar_t* upperHalf);
+
+    struct ReverseEntry
+    {
+        wchar_t c;
+        BYTE    b;
+    };
+
+    UINT           codePage;
+    const wchar_t* upperHalf;      ///< UTF16 chars for the bytes 0x80-0xFF
+    ReverseEntry   reverse[128];   ///< upperHalf sorted by char, to convert back
+};
@@ -0,0 +1,207 @@
+// sktoolslib - common files for SK tools
+
+// Copyright (C) 2026 - Stefan Kueng
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+#pragma once
+
+#include <charconv>
+#include <climits>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+/**
+ * splits a string into tokens without allocating: the tokens are views
+ * into the string, which must stay alive while the tokens are used.
+ * The tokens are the same as the ones stringtok() creates: with \c trim
+ * set, empty tokens are skipped, and a delimiter at the end of the string
+ * doesn't start another token.
+ * Delimiters below 256 are looked up in a bitmap.
+ *
+ * @code
+ * for (auto token : CStringTokenizerW(list, L"|;", true))
+ *     DoSomething(token);
+ * @endcode
+ */
+template <typename CharT>
+class CStringTokenizerT
+{
+public:
+    using view_type = std::basic_string_view<CharT>;
+
+    class iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type        = view_type;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const view_type*;
+        using reference         = const view_type&;
+
+        iterator() = default;
+        iterator(const CStringTokenizerT* tokenizer, size_t pos)
+            : tokenizer(tokenizer)
+        {
+            Load(pos);
+        }
+
+        reference operator*() const { return token; }
+        pointer   operator->() const { return &token; }
+        iterator& operator++()
+        {
+            Load(next);
+            return *this;
+        }
+        iterator operator++(int)
+        {
+            iterator tmp = *this;
+            Load(next);
+            return tmp;
+        }
+        bool operator==(const iterator& other) const { return next == other.next; }
+        bool operator!=(const iterator& other) const { return next != other.next; }
+
+    private:
+        void Load(size_t pos)
+        {
+            const view_type& text = tokenizer->text;
+            if ((pos < text.size()) && tokenizer->trim)
+                pos = tokenizer->SkipDelimiters(pos);
+            if (pos >= text.size())
+            {
+                next  = view_type::npos;
+                token = view_type();
+                return;
+            }
+            size_t end = tokenizer->FindDelimiter(pos);
+            token      = text.substr(pos, end - pos);
+            next       = end + 1;
+        }
+
+        const CStringTokenizerT* tokenizer = nullptr;
+        size_t                   next      = view_type::npos;
+        view_type                token;
+    };
+
+    CStringTokenizerT(view_type text, const CharT* delimiters, bool trim)
+        : text(text)
+        , delimiters(delimiters)
+        , trim(trim)
+        , bitmap{}
+        , wideDelimiters(false)
+    {
+        for (CharT c : this->delimiters)
+        {
+            auto u = static_cast<std::make_unsigned_t<CharT>>(c);
+            if (u < 256)
+                bitmap[u >> 6] |= 1ULL << (u & 63);
+            else
+                wideDelimiters = true;
+        }
+    }
+
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(); }
+
+    bool IsDelimiter(CharT c) const
+    {
+        auto u = static_cast<std::make_unsigned_t<CharT>>(c);
+        if (u < 256)
+            return (bitmap[u >> 6] >> (u & 63)) & 1;
+        return wideDelimiters && (delimiters.find(c) != view_type::npos);
+    }
+
+private:
+    size_t FindDelimiter(size_t pos) const
+    {
+        while ((pos < text.size()) && !IsDelimiter(text[pos]))
+            ++pos;
+        return pos;
+    }
+
+    size_t SkipDelimiters(size_t pos) const
+    {
+        while ((pos < text.size()) && IsDelimiter(text[pos]))
+            ++pos;
+        return pos;
+    }
+
+    view_type     text;
+    view_type     delimiters;
+    bool          trim;
+    std::uint64_t bitmap[4];
+    bool          wideDelimiters;
+};
+
+using CStringTokenizer  = CStringTokenizerT<char>;
+using CStringTokenizerW = CStringTokenizerT<wchar_t>;
+
+/// parses a token like _atoi64() and _wtoi64() do: leading white space is
+/// skipped, parsing stops at the first char that's not a digit, and values
+/// that don't fit are clamped
+template <typename CharT>
+long long ParseTokenInt64(std::basic_string_view<CharT> token)
+{
+    size_t i = 0;
+    while ((i < token.size()) && ((token[i] == ' ') || ((token[i] >= '\t') && (token[i] <= '\r'))))
+        ++i;
+    bool negative = false;
+    if ((i < token.size()) && ((token[i] == '+') || (token[i] == '-')))
+        negative = (token[i++] == '-');
+    while ((i + 1 < token.size()) && (token[i] == '0'))
+        ++i;
+    // from_chars only parses chars, so the digits are copied first
+    char   digits[24];
+    size_t count = 0;
+    if (negative)
+        digits[count++] = '-';
+    for (; (i < token.size()) && (token[i] >= '0') && (token[i] <= '9'); ++i)
+    {
+        if (count == sizeof(digits))
+            return negative ? LLONG_MIN : LLONG_MAX;
+        digits[count++] = static_cast<char>(token[i]);
+    }
+    long long value  = 0;
+    auto      result = std::from_chars(digits, digits + count, value);
+    if (result.ec == std::errc::result_out_of_range)
+        return negative ? LLONG_MIN : LLONG_MAX;
+    return value;
+}
+
+/// true for string views, which must not outlive the string they point into
+template <typename T>
+struct IsStringView : std::false_type
+{
+};
+template <typename CharT, typename Traits>
+struct IsStringView<std::basic_string_view<CharT, Traits>> : std::true_type
+{
+};
+
+/// converts a token to the value type of a container: strings and string
+/// views are constructed from the token, numbers are parsed
+template <typename T, typename CharT>
+T TokenValue(std::basic_string_view<CharT> token)
+{
+    if constexpr (std::is_constructible_v<T, std::basic_string_view<CharT>>)
+        return T(token);
+    else
+        return static_cast<T>(ParseTokenInt64(token));
+}
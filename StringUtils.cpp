@@ -1,6 +1,6 @@
 ﻿// sktoolslib - common files for SK tools
 
-// Copyright (C) 2012-2017, 2019-2021, 2024 - Stefan Kueng
+// Copyright (C) 2012-2017, 2019-2021, 2024, 2026 - Stefan Kueng
 
 // This program is free software; you can redistribute it and/or
 // modify it under the terms of the GNU General Public License
@@ -19,12 +19,20 @@
 
 #include "stdafx.h"
 #include "StringUtils.h"
+#include "Base64.h"
+#include "CaseFold.h"
 #include "OnOutOfScope.h"
 
 #include <Wincrypt.h>
 
+#if defined(_M_IX86) || defined(_M_X64)
+#    include <emmintrin.h>
+#endif
+
 #pragma comment(lib, "Crypt32.lib")
 
+static BOOL sse2Supported = ::IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE);
+
 int strwildcmp(const char* wild, const char* str)
 {
     const char* cp = nullptr;
@@ -117,7 +125,7 @@ int wcswildicmp(const wchar_t* wild, const wchar_t* str)
     const wchar_t* mp = nullptr;
     while ((*str) && (*wild != L'*'))
     {
-        if ((*wild != L'?') && (::towlower(*wild) != ::towlower(*str)))
+        if ((*wild != L'?') && (CCaseFold::Fold(*wild) != CCaseFold::Fold(*str)))
         {
             return 0;
         }
@@ -135,7 +143,7 @@ int wcswildicmp(const wchar_t* wild, const wchar_t* str)
             mp = wild;
             cp = str + 1;
         }
-        else if ((*wild == L'?') || (::towlower(*wild) == ::towlower(*str)))
+        else if ((*wild == L'?') || (CCaseFold::Fold(*wild) == CCaseFold::Fold(*str)))
         {
             wild++;
             str++;
@@ -171,50 +179,90 @@ static constexpr BYTE HexLookup[513] = {
     "d0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
     "e0e1e2e3e4e5e6e7e8e9eaebecedeeef"
     "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff"};
-static constexpr BYTE DecLookup[] = {
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // gap before first hex digit
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 1, 2, 3, 4, 5, 6, 7, 8, 9,          // 0123456789
-    0, 0, 0, 0, 0, 0, 0,                   // :;<=>?@ (gap)
-    10, 11, 12, 13, 14, 15,                // ABCDEF
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // GHIJKLMNOPQRS (gap)
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // TUVWXYZ[/]^_` (gap)
-    10, 11, 12, 13, 14, 15                 // abcdef
-};
-
-std::string CStringUtils::ToHexString(BYTE* pSrc, int nSrcLen)
+
+// returns the value of a hex digit, -1 if the char is not a hex digit
+static int HexDigitValue(char c)
+{
+    if ((c >= '0') && (c <= '9'))
+        return c - '0';
+    c |= 0x20;
+    if ((c >= 'a') && (c <= 'f'))
+        return c - 'a' + 10;
+    return -1;
+}
+
+std::string CStringUtils::ToHexString(const BYTE* pSrc, size_t nSrcLen)
 {
-    WORD* pwHex  = reinterpret_cast<WORD*>(const_cast<BYTE*>(HexLookup));
-    auto  dest   = std::make_unique<char[]>((nSrcLen * 2LL) + 1LL);
-    WORD* pwDest = reinterpret_cast<WORD*>(dest.get());
-    for (int j = 0; j < nSrcLen; j++)
+    std::string result(nSrcLen * 2, '\0');
+    char*       pDest = result.data();
+    size_t      i     = 0;
+#if defined(_M_IX86) || defined(_M_X64)
+    if (sse2Supported)
     {
-        *pwDest = pwHex[*pSrc];
-        pwDest++;
-        pSrc++;
+        // the nibbles of 16 bytes are converted at once: '0' is added to
+        // each, and for the nibbles above 9 the gap between '9' and 'a'
+        const __m128i nibble = _mm_set1_epi8(0x0F);
+        const __m128i nine   = _mm_set1_epi8(9);
+        const __m128i zero   = _mm_set1_epi8('0');
+        const __m128i gap    = _mm_set1_epi8('a' - '0' - 10);
+        auto          toHex  = [&](__m128i n) { return _mm_add_epi8(_mm_add_epi8(n, zero), _mm_and_si128(_mm_cmpgt_epi8(n, nine), gap)); };
+        for (; i + 16 <= nSrcLen; i += 16)
+        {
+            __m128i in   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i));
+            __m128i high = toHex(_mm_and_si128(_mm_srli_epi16(in, 4), nibble));
+            __m128i low  = toHex(_mm_and_si128(in, nibble));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pDest + 2 * i), _mm_unpacklo_epi8(high, low));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pDest + 2 * i + 16), _mm_unpackhi_epi8(high, low));
+        }
     }
-    *reinterpret_cast<BYTE*>(pwDest) = 0; // terminate the string
-    return std::string(dest.get());
+#endif
+    for (; i < nSrcLen; ++i)
+        memcpy(pDest + 2 * i, &HexLookup[2 * pSrc[i]], 2);
+    return result;
 }
 
-bool CStringUtils::FromHexString(const std::string& src, BYTE* pDest)
+bool CStringUtils::FromHexString(std::string_view src, BYTE* pDest)
 {
     if (src.size() % 2)
         return false;
-    for (auto it = src.cbegin(); it != src.cend(); ++it)
+    size_t i = 0;
+#if defined(_M_IX86) || defined(_M_X64)
+    if (sse2Supported)
     {
-        if ((*it < '0') || (*it > 'f'))
+        // converts 16 hex digits to 8 bytes in the low bytes of the words
+        auto toBytes = [](__m128i c, bool& valid) {
+            __m128i lower  = _mm_or_si128(c, _mm_set1_epi8(0x20));
+            __m128i digit  = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), c));
+            __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('f' + 1), lower));
+            valid          = valid && (_mm_movemask_epi8(_mm_or_si128(digit, letter)) == 0xFFFF);
+            __m128i values = _mm_or_si128(_mm_and_si128(digit, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+                                          _mm_and_si128(letter, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+            // the first digit of a pair is in the low byte of the word
+            return _mm_or_si128(_mm_slli_epi16(_mm_and_si128(values, _mm_set1_epi16(0x00FF)), 4), _mm_srli_epi16(values, 8));
+        };
+        for (; i + 32 <= src.size(); i += 32)
+        {
+            bool    valid  = true;
+            __m128i first  = toBytes(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src.data() + i)), valid);
+            __m128i second = toBytes(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src.data() + i + 16)), valid);
+            if (!valid)
+                return false;
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pDest + i / 2), _mm_packus_epi16(first, second));
+        }
+    }
+#endif
+    for (; i < src.size(); i += 2)
+    {
+        int high = HexDigitValue(src[i]);
+        int low  = HexDigitValue(src[i + 1]);
+        if ((high < 0) || (low < 0))
             return false;
-        int d = DecLookup[*it] << 4;
-        ++it;
-        d |= DecLookup[*it];
-        *pDest++ = static_cast<BYTE>(d);
+        pDest[i / 2] = static_cast<BYTE>((high << 4) | low);
     }
     return true;
 }
 
-std::wstring CStringUtils::ToHexWString(BYTE* pSrc, int nSrcLen)
+std::wstring CStringUtils::ToHexWString(const BYTE* pSrc, size_t nSrcLen)
 {
     std::string s = ToHexString(pSrc, nSrcLen);
     return std::wstring(s.begin(), s.end());
@@ -222,46 +270,14 @@ std::wstring CStringUtils::ToHexWString(BYTE* pSrc, int nSrcLen)
 
 std::string CStringUtils::base64_encode(const std::string& in)
 {
-    std::string out;
-
-    int         val = 0, valb = -6;
-    for (auto c : in)
-    {
-        val = (val << 8) + c;
-        valb += 8;
-        while (valb >= 0)
-        {
-            out.push_back("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"[(val >> valb) & 0x3F]);
-            valb -= 6;
-        }
-    }
-    if (valb > -6)
-        out.push_back("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"[((val << 8) >> (valb + 8)) & 0x3F]);
-    while (out.size() % 4)
-        out.push_back('=');
-    return out;
+    return CBase64::Encode(reinterpret_cast<const BYTE*>(in.data()), in.size());
 }
+
 std::string CStringUtils::base64_decode(const std::string& in)
 {
-    std::string      out;
-
-    std::vector<int> T(256, -1);
-    for (int i = 0; i < 64; i++)
-        T["ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"[i]] = i;
-
-    int val = 0, valb = -8;
-    for (auto c : in)
-    {
-        if (T[c] == -1)
-            break;
-        val = (val << 6) + T[c];
-        valb += 6;
-        if (valb >= 0)
-        {
-            out.push_back(static_cast<char>((val >> valb) & 0xFF));
-            valb -= 8;
-        }
-    }
+    // like before, decoding stops at the first char that's not base64
+    std::string out;
+    CBase64::Decode(in, out);
     return out;
 }
 
@@ -365,49 +381,107 @@ std::wstring CStringUtils::Encrypt(const wchar_t* text)
     return result;
 }
 
-std::wstring CStringUtils::Format(const wchar_t* frmt, ...)
+// size of the stack buffer the format functions try first. Almost all
+// formatted strings (paths, log lines, status texts) fit into it.
+static constexpr size_t formatStackBufferSize = 512;
+
+void CStringUtils::AppendFormatV(std::wstring& dst, const wchar_t* frmt, va_list args)
 {
-    std::wstring buffer;
-    if (frmt != nullptr)
+    if (frmt == nullptr)
+        return;
+
+    // the arguments are consumed by the first attempt, keep a copy for the
+    // case where the output does not fit into the stack buffer
+    va_list retryArgs;
+    va_copy(retryArgs, args);
+
+    wchar_t stackBuf[formatStackBufferSize];
+    auto    len = _vsnwprintf_s(stackBuf, _countof(stackBuf), _TRUNCATE, frmt, args);
+    if (len >= 0)
+        dst.append(stackBuf, len);
+    else
     {
-        va_list marker;
-
-        va_start(marker, frmt);
-
-        // Get formatted string length adding one for the NUL
-        auto len = _vscwprintf(frmt, marker);
+        // output did not fit: get the real length and format directly into dst
+        va_list writeArgs;
+        va_copy(writeArgs, retryArgs);
+        len = _vscwprintf(frmt, retryArgs);
         if (len > 0)
         {
-            buffer.resize(len + 1LL);
-            _vsnwprintf_s(&buffer[0], buffer.size(), len, frmt, marker);
-            buffer.resize(len);
+            auto oldSize = dst.size();
+            dst.resize(oldSize + len + 1);
+            _vsnwprintf_s(&dst[oldSize], len + 1LL, len, frmt, writeArgs);
+            dst.resize(oldSize + len);
         }
-
-        va_end(marker);
+        va_end(writeArgs);
     }
-    return buffer;
+    va_end(retryArgs);
 }
 
-std::string CStringUtils::Format(const char* frmt, ...)
+void CStringUtils::AppendFormatV(std::string& dst, const char* frmt, va_list args)
 {
-    std::string buffer;
-    if (frmt != nullptr)
+    if (frmt == nullptr)
+        return;
+
+    // the arguments are consumed by the first attempt, keep a copy for the
+    // case where the output does not fit into the stack buffer
+    va_list retryArgs;
+    va_copy(retryArgs, args);
+
+    char stackBuf[formatStackBufferSize];
+    auto len = _vsnprintf_s(stackBuf, _countof(stackBuf), _TRUNCATE, frmt, args);
+    if (len >= 0)
+        dst.append(stackBuf, len);
+    else
     {
-        va_list marker;
-
-        va_start(marker, frmt);
-
-        // Get formatted string length adding one for the NUL
-        auto len = _vscprintf(frmt, marker);
+        // output did not fit: get the real length and format directly into dst
+        va_list writeArgs;
+        va_copy(writeArgs, retryArgs);
+        len = _vscprintf(frmt, retryArgs);
         if (len > 0)
         {
-            buffer.resize(len + 1LL);
-            _vsnprintf_s(&buffer[0], buffer.size(), len, frmt, marker);
-            buffer.resize(len);
+            auto oldSize = dst.size();
+            dst.resize(oldSize + len + 1);
+            _vsnprintf_s(&dst[oldSize], len + 1LL, len, frmt, writeArgs);
+            dst.resize(oldSize + len);
         }
-
-        va_end(marker);
+        va_end(writeArgs);
     }
+    va_end(retryArgs);
+}
+
+void CStringUtils::AppendFormat(std::wstring& dst, const wchar_t* frmt, ...)
+{
+    va_list marker;
+    va_start(marker, frmt);
+    AppendFormatV(dst, frmt, marker);
+    va_end(marker);
+}
+
+void CStringUtils::AppendFormat(std::string& dst, const char* frmt, ...)
+{
+    va_list marker;
+    va_start(marker, frmt);
+    AppendFormatV(dst, frmt, marker);
+    va_end(marker);
+}
+
+std::wstring CStringUtils::Format(const wchar_t* frmt, ...)
+{
+    std::wstring buffer;
+    va_list      marker;
+    va_start(marker, frmt);
+    AppendFormatV(buffer, frmt, marker);
+    va_end(marker);
+    return buffer;
+}
+
+std::string CStringUtils::Format(const char* frmt, ...)
+{
+    std::string buffer;
+    va_list     marker;
+    va_start(marker, frmt);
+    AppendFormatV(buffer, frmt, marker);
+    va_end(marker);
     return buffer;
 }
 
@@ -446,70 +520,84 @@ bool WriteAsciiStringToClipboard(const wchar_t* sClipdata, HWND hOwningWnd)
     return false;
 }
 
-void SearchReplace(std::wstring& str, const std::wstring& toreplace, const std::wstring& replacewith)
+template <typename CharT>
+static size_t SearchReplaceT(std::basic_string_view<CharT> str, std::basic_string_view<CharT> toreplace, std::basic_string_view<CharT> replacewith, std::basic_string<CharT>& dst)
 {
-    std::wstring            result;
-    std::wstring::size_type pos = 0;
-    for (;;)
+    size_t count = 0;
+    size_t pos   = 0;
+    if (!toreplace.empty())
     {
-        std::wstring::size_type next = str.find(toreplace, pos);
-        result.append(str, pos, next - pos);
-        if (next != std::wstring::npos)
+        for (size_t next = str.find(toreplace); next != str.npos; next = str.find(toreplace, pos))
         {
-            result.append(replacewith);
+            if (count++ == 0)
+                dst.reserve(dst.size() + str.size());
+            dst.append(str.substr(pos, next - pos));
+            dst.append(replacewith);
             pos = next + toreplace.size();
         }
-        else
-        {
-            break; // exit loop
-        }
     }
+    dst.append(str.substr(pos));
+    return count;
+}
+
+template <typename CharT>
+static void SearchReplaceT(std::basic_string<CharT>& str, std::basic_string_view<CharT> toreplace, std::basic_string_view<CharT> replacewith)
+{
+    // don't build a new string if there's nothing to replace
+    if (toreplace.empty() || (str.find(toreplace) == str.npos))
+        return;
+    std::basic_string<CharT> result;
+    SearchReplaceT<CharT>(str, toreplace, replacewith, result);
     str = std::move(result);
 }
 
-void SearchReplace(std::string& str, const std::string& toreplace, const std::string& replacewith)
+// moves the text between the matches to the front, so every char is moved only once
+template <typename CharT>
+static void SearchRemoveAllT(std::basic_string<CharT>& str, std::basic_string_view<CharT> toremove)
 {
-    std::string            result;
-    std::string::size_type pos = 0;
-    for (;;)
+    if (toremove.empty())
+        return;
+    size_t pos = str.find(toremove);
+    if (pos == str.npos)
+        return;
+    size_t out = pos;
+    while (pos != str.npos)
     {
-        std::string::size_type next = str.find(toreplace, pos);
-        result.append(str, pos, next - pos);
-        if (next != std::string::npos)
-        {
-            result.append(replacewith);
-            pos = next + toreplace.size();
-        }
-        else
-        {
-            break; // exit loop
-        }
+        size_t in  = pos + toremove.size();
+        pos        = str.find(toremove, in);
+        size_t end = (pos == str.npos) ? str.size() : pos;
+        std::copy(str.begin() + in, str.begin() + end, str.begin() + out);
+        out += end - in;
     }
-    str = std::move(result);
+    str.resize(out);
+}
+
+void SearchReplace(std::wstring& str, const std::wstring& toreplace, const std::wstring& replacewith)
+{
+    SearchReplaceT<wchar_t>(str, toreplace, replacewith);
+}
+
+void SearchReplace(std::string& str, const std::string& toreplace, const std::string& replacewith)
+{
+    SearchReplaceT<char>(str, toreplace, replacewith);
+}
+
+size_t SearchReplace(std::wstring_view str, std::wstring_view toreplace, std::wstring_view replacewith, std::wstring& dst)
+{
+    return SearchReplaceT<wchar_t>(str, toreplace, replacewith, dst);
+}
+
+size_t SearchReplace(std::string_view str, std::string_view toreplace, std::string_view replacewith, std::string& dst)
+{
+    return SearchReplaceT<char>(str, toreplace, replacewith, dst);
 }
 
 void SearchRemoveAll(std::string& str, const std::string& toremove)
 {
-    std::string::size_type pos = 0;
-    for (;;)
-    {
-        auto nextPos = str.find(toremove, pos);
-        if (nextPos == std::string::npos)
-            break;
-        str.erase(nextPos, toremove.length());
-        pos = nextPos;
-    }
+    SearchRemoveAllT<char>(str, toremove);
 }
 
 void SearchRemoveAll(std::wstring& str, const std::wstring& toremove)
 {
-    std::wstring::size_type pos = 0;
-    for (;;)
-    {
-        auto nextPos = str.find(toremove, pos);
-        if (nextPos == std::wstring::npos)
-            break;
-        str.erase(nextPos, toremove.length());
-        pos = nextPos;
-    }
+    SearchRemoveAllT<wchar_t>(str, toremove);
 }
@@ -1,6 +1,6 @@
 ﻿// sktoolslib - common files for SK tools
 
-// Copyright (C) 2012-2022, 2024 - Stefan Kueng
+// Copyright (C) 2012-2022, 2024, 2026 - Stefan Kueng
 
 // This program is free software; you can redistribute it and/or
 // modify it under the terms of the GNU General Public License
@@ -19,10 +19,22 @@
 
 #pragma once
 
+#include "CaseFold.h"
+#include "StringTokenizer.h"
+
 #include <string>
+#include <string_view>
 #include <algorithm>
+#include <cstdarg>
 #include <functional>
 #include <memory>
+#if __has_include(<version>)
+#    include <version>
+#endif
+#if defined(__cpp_lib_format) && __cpp_lib_format >= 202207L
+#    include <format>
+#    include <iterator>
+#endif
 
 /**
  * @ingroup Utils
@@ -54,6 +66,10 @@ int  wcswildicmp(const wchar_t* wild, const wchar_t* string);
 bool WriteAsciiStringToClipboard(const wchar_t* sClipdata, HWND hOwningWnd);
 void SearchReplace(std::wstring& str, const std::wstring& toreplace, const std::wstring& replacewith);
 void SearchReplace(std::string& str, const std::string& toreplace, const std::string& replacewith);
+/// appends \c str with all occurrences of \c toreplace replaced to \c dst.
+/// Returns the number of replacements. Use CMultiReplacer to replace several strings at once.
+size_t SearchReplace(std::wstring_view str, std::wstring_view toreplace, std::wstring_view replacewith, std::wstring& dst);
+size_t SearchReplace(std::string_view str, std::string_view toreplace, std::string_view replacewith, std::string& dst);
 
 void SearchRemoveAll(std::string& str, const std::string& toremove);
 void SearchRemoveAll(std::wstring& str, const std::wstring& toremove);
@@ -63,104 +79,37 @@ template <typename Container>
 void stringtok(Container& container, const std::wstring& in, bool trim,
                const wchar_t* const delimiters = L"|", bool append = true)
 {
-    const std::wstring::size_type len = in.length();
-    std::wstring::size_type       i   = 0;
     if (!append)
         container.clear();
+    for (auto token : CStringTokenizerW(in, delimiters, trim))
+        container.push_back(TokenValue<typename Container::value_type>(token));
+}
 
-    while (i < len)
-    {
-        if (trim)
-        {
-            // eat leading whitespace
-            i = in.find_first_not_of(delimiters, i);
-            if (i == std::wstring::npos)
-                return; // nothing left but white space
-        }
-
-        // find the end of the token
-        std::wstring::size_type j = in.find_first_of(delimiters, i);
-
-        // push token
-        if (j == std::wstring::npos)
-        {
-            if constexpr (std::is_same_v<typename Container::value_type, std::wstring>)
-            {
-                container.push_back(in.substr(i));
-            }
-            else
-            {
-                container.push_back(static_cast<typename Container::value_type>(_wtoi64(in.substr(i).c_str())));
-            }
-            return;
-        }
-        else
-        {
-            if constexpr (std::is_same_v<typename Container::value_type, std::wstring>)
-            {
-                container.push_back(in.substr(i, j - i));
-            }
-            else
-            {
-                container.push_back(static_cast<typename Container::value_type>(_wtoi64(in.substr(i, j - i).c_str())));
-            }
-        }
-
-        // set up for next loop
-        i = j + 1;
-    }
+// string views would point into the temporary string
+template <typename Container>
+void stringtok(Container& container, std::wstring&& in, bool trim,
+               const wchar_t* const delimiters = L"|", bool append = true)
+{
+    static_assert(!IsStringView<typename Container::value_type>::value, "the tokens would outlive the temporary string");
+    stringtok(container, static_cast<const std::wstring&>(in), trim, delimiters, append);
 }
 
 template <typename Container>
 void stringtokset(Container& container, const std::wstring& in, bool trim,
                   const wchar_t* const delimiters = L"|", bool append = false)
 {
-    const std::wstring::size_type len = in.length();
-    std::wstring::size_type       i   = 0;
     if (!append)
         container.clear();
+    for (auto token : CStringTokenizerW(in, delimiters, trim))
+        container.insert(TokenValue<typename Container::value_type>(token));
+}
 
-    while (i < len)
-    {
-        if (trim)
-        {
-            // eat leading whitespace
-            i = in.find_first_not_of(delimiters, i);
-            if (i == std::wstring::npos)
-                return; // nothing left but white space
-        }
-
-        // find the end of the token
-        std::wstring::size_type j = in.find_first_of(delimiters, i);
-
-        // push token
-        if (j == std::wstring::npos)
-        {
-            if constexpr (std::is_same_v<typename Container::value_type, std::wstring>)
-            {
-                container.insert(in.substr(i));
-            }
-            else
-            {
-                container.insert(static_cast<typename Container::value_type>(_wtoi64(in.substr(i).c_str())));
-            }
-            return;
-        }
-        else
-        {
-            if constexpr (std::is_same_v<typename Container::value_type, std::wstring>)
-            {
-                container.insert(in.substr(i, j - i));
-            }
-            else
-            {
-                container.insert(static_cast<typename Container::value_type>(_wtoi64(in.substr(i, j - i).c_str())));
-            }
-        }
-
-        // set up for next loop
-        i = j + 1;
-    }
+template <typename Container>
+void stringtokset(Container& container, std::wstring&& in, bool trim,
+                  const wchar_t* const delimiters = L"|", bool append = false)
+{
+    static_assert(!IsStringView<typename Container::value_type>::value, "the tokens would outlive the temporary string");
+    stringtokset(container, static_cast<const std::wstring&>(in), trim, delimiters, append);
 }
 
 // append = true as the default: a default value should never lose data!
@@ -168,104 +117,36 @@ template <typename Container>
 void stringtok(Container& container, const std::string& in, bool trim,
                const char* const delimiters = "|", bool append = true)
 {
-    const std::string::size_type len = in.length();
-    std::string::size_type       i   = 0;
     if (!append)
         container.clear();
+    for (auto token : CStringTokenizer(in, delimiters, trim))
+        container.push_back(TokenValue<typename Container::value_type>(token));
+}
 
-    while (i < len)
-    {
-        if (trim)
-        {
-            // eat leading whitespace
-            i = in.find_first_not_of(delimiters, i);
-            if (i == std::string::npos)
-                return; // nothing left but white space
-        }
-
-        // find the end of the token
-        std::string::size_type j = in.find_first_of(delimiters, i);
-
-        // push token
-        if (j == std::string::npos)
-        {
-            if constexpr (std::is_same_v<typename Container::value_type, std::string>)
-            {
-                container.push_back(in.substr(i));
-            }
-            else
-            {
-                container.push_back(static_cast<typename Container::value_type>(_atoi64(in.substr(i).c_str())));
-            }
-            return;
-        }
-        else
-        {
-            if constexpr (std::is_same_v<typename Container::value_type, std::string>)
-            {
-                container.push_back(in.substr(i, j - i));
-            }
-            else
-            {
-                container.push_back(static_cast<typename Container::value_type>(_atoi64(in.substr(i, j - i).c_str())));
-            }
-        }
-
-        // set up for next loop
-        i = j + 1;
-    }
+template <typename Container>
+void stringtok(Container& container, std::string&& in, bool trim,
+               const char* const delimiters = "|", bool append = true)
+{
+    static_assert(!IsStringView<typename Container::value_type>::value, "the tokens would outlive the temporary string");
+    stringtok(container, static_cast<const std::string&>(in), trim, delimiters, append);
 }
 
 template <typename Container>
 void stringtokset(Container& container, const std::string& in, bool trim,
                   const char* const delimiters = "|", bool append = false)
 {
-    const std::string::size_type len = in.length();
-    std::string::size_type       i   = 0;
     if (!append)
         container.clear();
+    for (auto token : CStringTokenizer(in, delimiters, trim))
+        container.insert(TokenValue<typename Container::value_type>(token));
+}
 
-    while (i < len)
-    {
-        if (trim)
-        {
-            // eat leading whitespace
-            i = in.find_first_not_of(delimiters, i);
-            if (i == std::string::npos)
-                return; // nothing left but white space
-        }
-
-        // find the end of the token
-        std::string::size_type j = in.find_first_of(delimiters, i);
-
-        // push token
-        if (j == std::string::npos)
-        {
-            if constexpr (std::is_same_v<typename Container::value_type, std::string>)
-            {
-                container.insert(in.substr(i));
-            }
-            else
-            {
-                container.insert(static_cast<typename Container::value_type>(_atoi64(in.substr(i).c_str())));
-            }
-            return;
-        }
-        else
-        {
-            if constexpr (std::is_same_v<typename Container::value_type, std::string>)
-            {
-                container.insert(in.substr(i, j - i));
-            }
-            else
-            {
-                container.insert(static_cast<typename Container::value_type>(_atoi64(in.substr(i, j - i).c_str())));
-            }
-        }
-
-        // set up for next loop
-        i = j + 1;
-    }
+template <typename Container>
+void stringtokset(Container& container, std::string&& in, bool trim,
+                  const char* const delimiters = "|", bool append = false)
+{
+    static_assert(!IsStringView<typename Container::value_type>::value, "the tokens would outlive the temporary string");
+    stringtokset(container, static_cast<const std::string&>(in), trim, delimiters, append);
 }
 
 // ReSharper disable once CppInconsistentNaming
@@ -324,18 +205,22 @@ std::string to_bit_string(T number, bool trimSignificantClearBits)
 /// use it as the second/third argument when creating a container, e.g.:
 /// std::map< std::string, std::vector<std::string>, ci_less > myMap;
 /// std::vector<std::string, ci_less> myVector;
+/// The comparison is transparent, so a map can be searched with a string_view
+/// or a string literal without creating a temporary string.
 // ReSharper disable once CppInconsistentNaming
 struct ci_less
 {
+    using is_transparent = void;
+
     // case-independent (ci) compare_less binary function
     struct NocaseCompare
     {
         bool operator()(const unsigned char& c1, const unsigned char& c2) const
         {
-            return tolower(c1) < tolower(c2);
+            return ((c1 >= 'A' && c1 <= 'Z') ? (c1 | 0x20) : c1) < ((c2 >= 'A' && c2 <= 'Z') ? (c2 | 0x20) : c2);
         }
     };
-    bool operator()(const std::string& s1, const std::string& s2) const
+    bool operator()(std::string_view s1, std::string_view s2) const
     {
         return std::lexicographical_compare(s1.begin(), s1.end(), // source range
                                             s2.begin(), s2.end(), // dest range
@@ -346,15 +231,17 @@ struct ci_less
 // ReSharper disable once CppInconsistentNaming
 struct ci_lessW
 {
+    using is_transparent = void;
+
     // case-independent (ci) compare_less binary function
     struct NocaseCompare
     {
         bool operator()(const wchar_t& c1, const wchar_t& c2) const
         {
-            return towlower(c1) < towlower(c2);
+            return CCaseFold::Fold(c1) < CCaseFold::Fold(c2);
         }
     };
-    bool operator()(const std::wstring& s1, const std::wstring& s2) const
+    bool operator()(std::wstring_view s1, std::wstring_view s2) const
     {
         return std::lexicographical_compare(s1.begin(), s1.end(), // source range
                                             s2.begin(), s2.end(), // dest range
@@ -362,6 +249,43 @@ struct ci_lessW
     }
 };
 
+/// hash and equality helpers for case-insensitive unordered containers, e.g.:
+/// std::unordered_map<std::wstring, int, ci_hashW, ci_equalW> myMap;
+/// They fold the case the same way as ci_less and ci_lessW do. Both are
+/// transparent, so with C++20 a lookup with a string_view doesn't need a
+/// temporary string either.
+// ReSharper disable once CppInconsistentNaming
+struct ci_hash
+{
+    using is_transparent = void;
+
+    size_t operator()(std::string_view s) const { return CCaseFold::Hash(s); }
+};
+
+// ReSharper disable once CppInconsistentNaming
+struct ci_equal
+{
+    using is_transparent = void;
+
+    bool operator()(std::string_view s1, std::string_view s2) const { return CCaseFold::Equal(s1, s2); }
+};
+
+// ReSharper disable once CppInconsistentNaming
+struct ci_hashW
+{
+    using is_transparent = void;
+
+    size_t operator()(std::wstring_view s) const { return CCaseFold::Hash(s); }
+};
+
+// ReSharper disable once CppInconsistentNaming
+struct ci_equalW
+{
+    using is_transparent = void;
+
+    bool operator()(std::wstring_view s1, std::wstring_view s2) const { return CCaseFold::Equal(s1, s2); }
+};
+
 class CStringUtils
 {
 public:
@@ -474,9 +398,10 @@ public:
         return buf.get();
     }
 
-    static std::string                                                                                                   ToHexString(BYTE* pSrc, int nSrcLen);
-    static bool                                                                                                          FromHexString(const std::string& src, BYTE* pDest);
-    static std::wstring                                                                                                  ToHexWString(BYTE* pSrc, int nSrcLen);
+    static std::string                                                                                                   ToHexString(const BYTE* pSrc, size_t nSrcLen);
+    /// \c pDest needs room for src.size() / 2 bytes. Returns false if \c src has an odd length or chars that are not hex digits
+    static bool                                                                                                          FromHexString(std::string_view src, BYTE* pDest);
+    static std::wstring                                                                                                  ToHexWString(const BYTE* pSrc, size_t nSrcLen);
 
     static std::string                                                                                                   base64_encode(const std::string& in);
     static std::string                                                                                                   base64_decode(const std::string& in);
@@ -488,6 +413,33 @@ public:
 
     static std::wstring                                                                                                  Format(const wchar_t* frmt, ...);
     static std::string                                                                                                   Format(const char* frmt, ...);
+    /**
+     * Appends the printf style formatted string to \c dst instead of returning
+     * a new string. Output that fits into a small stack buffer is formatted in
+     * a single pass, only longer output needs a second pass to get its length.
+     */
+    static void                                                                                                          AppendFormat(std::wstring& dst, const wchar_t* frmt, ...);
+    static void                                                                                                          AppendFormat(std::string& dst, const char* frmt, ...);
+    static void                                                                                                          AppendFormatV(std::wstring& dst, const wchar_t* frmt, va_list args);
+    static void                                                                                                          AppendFormatV(std::string& dst, const char* frmt, va_list args);
+
+#if defined(__cpp_lib_format) && __cpp_lib_format >= 202207L
+    // std::format_string is only public since C++23 (P2508)
+    /**
+     * Type safe variants of AppendFormat using std::format syntax. The format
+     * string is checked at compile time and the output is appended to \c dst.
+     */
+    template <typename... Args>
+    static void FormatTo(std::wstring& dst, std::wformat_string<Args...> frmt, Args&&... args)
+    {
+        std::format_to(std::back_inserter(dst), frmt, std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    static void FormatTo(std::string& dst, std::format_string<Args...> frmt, Args&&... args)
+    {
+        std::format_to(std::back_inserter(dst), frmt, std::forward<Args>(args)...);
+    }
+#endif
 
     [[deprecated("use case insensitive string comparison instead, or the ci_less container helper")]] static inline void emplace_to_lower(std::wstring& s)
     {
@@ -531,18 +483,10 @@ public:
     //     }
     //     return it;
     // }
+    /// to search many strings for the same needle, use a CCaseInsensitiveSearcher directly
     static size_t find_caseinsensitive(const std::wstring& haystack, const std::wstring& needle)
     {
-        auto ret = std::wstring::npos;
-        for (size_t i = 0; i < haystack.size(); ++i)
-        {
-            if (_wcsnicmp(&haystack[i], needle.c_str(), needle.size()) == 0)
-            {
-                ret = i;
-                break;
-            }
-        }
-        return ret;
+        return CCaseInsensitiveSearcher(needle).Find(haystack);
     }
 
     template <typename T, typename T2>
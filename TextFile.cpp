@@ -1,6 +1,6 @@
 // sktoolslib - common files for SK tools
 
-// Copyright (C) 2012, 2014, 2017-2024 - Stefan Kueng
+// Copyright (C) 2012, 2014, 2017-2024, 2026 - Stefan Kueng
 
 // This program is free software; you can redistribute it and/or
 // modify it under the terms of the GNU General Public License
@@ -20,11 +20,28 @@
 #include "stdafx.h"
 #include "TextFile.h"
 #include "PathUtils.h"
+#include "UnicodeUtils.h"
+#include "SingleByteCodePage.h"
+#include "UTFTranscoder.h"
+#include "LineScanner.h"
 #include "maxpath.h"
 #include <memory>
 
 namespace
 {
+// number of bytes used to detect the encoding of files that are not read completely
+constexpr DWORD encodingSampleSize = 500000;
+
+// allocations done by all CTextFile objects
+std::atomic<UINT64> allocationCount = 0;
+std::atomic<UINT64> allocationBytes = 0;
+
+void CountAllocation(size_t bytes)
+{
+    ++allocationCount;
+    allocationBytes += bytes;
+}
+
 wchar_t WideCharSwap(wchar_t nValue)
 {
     return (((nValue >> 8)) | (nValue << 8));
@@ -60,11 +77,99 @@ auto sortedLowerBound(std::vector<size_t>::const_iterator first, const std::vect
     return first;
 }
 
+// opens a file for reading, retrying a few times if it is locked
+HANDLE OpenFileForReading(LPCWSTR path)
+{
+    auto   pathBuf      = std::make_unique<wchar_t[]>(MAX_PATH_NEW);
+    HANDLE hFile        = INVALID_HANDLE_VALUE;
+    int    retryCounter = 0;
+
+    if ((wcslen(path) > 2) && (path[0] == '\\') && (path[1] == '\\'))
+    {
+        // UNC path
+        wcscpy_s(pathBuf.get(), MAX_PATH_NEW, L"\\\\?\\UNC");
+        wcscat_s(pathBuf.get(), MAX_PATH_NEW, &path[1]);
+    }
+    else
+    {
+        // 'normal' path
+        wcscpy_s(pathBuf.get(), MAX_PATH_NEW, L"\\\\?\\");
+        wcscat_s(pathBuf.get(), MAX_PATH_NEW, path);
+    }
+
+    do
+    {
+        if (retryCounter)
+            Sleep(20 + retryCounter * 50);
+        hFile = CreateFile(pathBuf.get(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        retryCounter++;
+    } while (hFile == INVALID_HANDLE_VALUE && retryCounter < 5);
+    return hFile;
+}
+
+// decodes \c len bytes of raw file content to UTF16
+bool DecodeText(const BYTE *pData, size_t len, CTextFile::UnicodeType encoding, UINT codePage, std::wstring &text)
+{
+    try
+    {
+        switch (encoding)
+        {
+            case CTextFile::Unicode_Le:
+                text.assign(reinterpret_cast<const wchar_t *>(pData), len / sizeof(wchar_t));
+                break;
+            case CTextFile::Unicode_Be:
+                text.assign(reinterpret_cast<const wchar_t *>(pData), len / sizeof(wchar_t));
+                for (auto &c : text)
+                    c = WideCharSwap(c);
+                break;
+            default:
+            {
+                text.clear();
+                if (len == 0)
+                    break;
+                if (const auto *pSingleByte = CSingleByteCodePage::Get(codePage))
+                {
+                    text.resize(len);
+                    pSingleByte->ToWide(reinterpret_cast<const char *>(pData), len, text.data());
+                    break;
+                }
+                DWORD  flags  = (codePage == CP_UTF8) ? 0 : MB_PRECOMPOSED;
+                LPCSTR pStart = reinterpret_cast<LPCSTR>(pData);
+                int    ret    = MultiByteToWideChar(codePage, flags, pStart, static_cast<int>(len), nullptr, 0);
+                text.resize(ret);
+                if (MultiByteToWideChar(codePage, flags, pStart, static_cast<int>(len), text.data(), ret) != ret)
+                {
+                    text.clear();
+                    return false;
+                }
+            }
+            break;
+        }
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+    return true;
+}
+
 } // namespace
 
 CTextFile::CTextFile()
     : pFileBuf(nullptr)
+    , fileBufSize(0)
     , fileLen(0)
+    , dataOffset(0)
+    , rawLines(false)
+    , useMapping(false)
+    , keepBytes(false)
+    , useCompactIndex(false)
+    , codePage(CP_ACP)
+    , ansiCodePage(CP_ACP)
+    , textDecoded(true)
+    , contentEncoded(true)
+    , positionMapBuilt(false)
     , encoding(AutoType)
     , hasBOM(false)
     , nullByteCount(2)
@@ -78,7 +183,7 @@ CTextFile::~CTextFile()
 
 bool CTextFile::Save(LPCWSTR path, bool keepFileDate) const
 {
-    if (pFileBuf == nullptr)
+    if (GetFileData() == nullptr)
         return false;
     FILETIME creationTime{};
     FILETIME lastAccessTime{};
@@ -103,7 +208,7 @@ bool CTextFile::Save(LPCWSTR path, bool keepFileDate) const
     }
 
     DWORD byteswritten;
-    if (!WriteFile(hFile, pFileBuf.get(), fileLen, &byteswritten, nullptr))
+    if (!WriteFile(hFile, GetFileData(), fileLen, &byteswritten, nullptr))
     {
         CloseHandle(hFile);
         return false;
@@ -114,38 +219,63 @@ bool CTextFile::Save(LPCWSTR path, bool keepFileDate) const
     return true;
 }
 
-bool CTextFile::Load(LPCWSTR path, UnicodeType &type, bool bUTF8, std::atomic_bool &bCancelled)
+void CTextFile::Reset()
 {
-    encoding = AutoType;
-    type     = AutoType;
-    LARGE_INTEGER lint;
-    pFileBuf            = nullptr;
-    auto   pathBuf      = std::make_unique<wchar_t[]>(MAX_PATH_NEW);
-    HANDLE hFile        = INVALID_HANDLE_VALUE;
-    int    retryCounter = 0;
+    // clear the content, but keep the allocated memory for the next file
+    mappedFile.Close();
+    textContent.clear();
+    linePositions.clear();
+    compactLines.Clear();
+    positionMap.Clear();
+    positionMapBuilt = false;
+    filename.clear();
+    fileLen     = 0;
+    dataOffset  = 0;
+    rawLines       = false;
+    textDecoded    = true;
+    contentEncoded = true;
+    codePage       = CP_ACP;
+    encoding    = AutoType;
+    hasBOM      = false;
+}
 
-    if ((wcslen(path) > 2) && (path[0] == '\\') && (path[1] == '\\'))
+CTextFile::AllocationCounters CTextFile::GetAllocationCounters()
+{
+    return {allocationCount, allocationBytes};
+}
+
+void CTextFile::ResetAllocationCounters()
+{
+    allocationCount = 0;
+    allocationBytes = 0;
+}
+
+bool CTextFile::ReserveFileBuf(DWORD size)
+{
+    if ((pFileBuf != nullptr) && (fileBufSize >= size))
+        return true;
+    pFileBuf    = nullptr;
+    fileBufSize = 0;
+    try
     {
-        // UNC path
-        wcscpy_s(pathBuf.get(), MAX_PATH_NEW, L"\\\\?\\UNC");
-        wcscat_s(pathBuf.get(), MAX_PATH_NEW, &path[1]);
+        pFileBuf = std::make_unique<BYTE[]>(size);
     }
-    else
+    catch (const std::exception &)
     {
-        // 'normal' path
-        wcscpy_s(pathBuf.get(), MAX_PATH_NEW, L"\\\\?\\");
-        wcscat_s(pathBuf.get(), MAX_PATH_NEW, path);
+        return false;
     }
+    fileBufSize = size;
+    CountAllocation(size);
+    return true;
+}
 
-    do
-    {
-        if (retryCounter)
-            Sleep(20 + retryCounter * 50);
-        hFile = CreateFile(pathBuf.get(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
-                           nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
-        retryCounter++;
-    } while (hFile == INVALID_HANDLE_VALUE && retryCounter < 5);
-
+bool CTextFile::Load(LPCWSTR path, UnicodeType &type, bool bUTF8, std::atomic_bool &bCancelled)
+{
+    Reset();
+    type = AutoType;
+    LARGE_INTEGER lint;
+    size_t        textCapacity = textContent.capacity();
+    HANDLE        hFile        = OpenFileForReading(path);
     if (hFile == INVALID_HANDLE_VALUE)
         return false;
     std::wstring wPath(path);
@@ -156,6 +286,12 @@ bool CTextFile::Load(LPCWSTR path, UnicodeType &type, bool bUTF8, std::atomic_bo
         CloseHandle(hFile);
         return false;
     }
+    if (useMapping && (lint.HighPart == 0) && (lint.LowPart > 0))
+    {
+        bool ret = LoadMapped(hFile, lint.LowPart, type, bUTF8, bCancelled);
+        CloseHandle(hFile);
+        return ret;
+    }
 
     MEMORYSTATUSEX memEx = {sizeof(MEMORYSTATUSEX)};
     GlobalMemoryStatusEx(&memEx);
@@ -163,8 +299,8 @@ bool CTextFile::Load(LPCWSTR path, UnicodeType &type, bool bUTF8, std::atomic_bo
     DWORD bytesRead   = 0;
     DWORD bytesToRead = min(lint.LowPart, DWORD(memEx.ullAvailPhys / 4UL));
     if (lint.HighPart)
-        bytesToRead = 500000; // read 50kb if the file is too big: we only
-                              // need to scan for the file type then.
+        bytesToRead = encodingSampleSize; // read 50kb if the file is too big: we only
+                                          // need to scan for the file type then.
 
     // if there isn't enough RAM available, only load a small part of the file
     // to do the encoding check. Then only load the full file in case
@@ -196,8 +332,7 @@ bool CTextFile::Load(LPCWSTR path, UnicodeType &type, bool bUTF8, std::atomic_bo
                     CloseHandle(hFile);
                     return false;
                 default:
-                    pFileBuf = std::make_unique<BYTE[]>(lint.LowPart);
-                    if (pFileBuf)
+                    if (ReserveFileBuf(lint.LowPart))
                     {
                         for (unsigned long bc = 0; bc < bytesRead; ++bc)
                         {
@@ -213,19 +348,11 @@ bool CTextFile::Load(LPCWSTR path, UnicodeType &type, bool bUTF8, std::atomic_bo
         }
     }
     else
+        ReserveFileBuf(lint.LowPart);
+    if ((pFileBuf == nullptr) || (fileBufSize < lint.LowPart) || (!ReadFile(hFile, pFileBuf.get(), lint.LowPart, &bytesRead, nullptr)))
     {
-        try
-        {
-            pFileBuf = std::make_unique<BYTE[]>(lint.LowPart);
-        }
-        catch (const std::exception &)
-        {
-            return false;
-        }
-    }
-    if ((pFileBuf == nullptr) || (!ReadFile(hFile, pFileBuf.get(), lint.LowPart, &bytesRead, nullptr)))
-    {
-        pFileBuf = nullptr;
+        pFileBuf    = nullptr;
+        fileBufSize = 0;
         CloseHandle(hFile);
         return false;
     }
@@ -241,6 +368,19 @@ bool CTextFile::Load(LPCWSTR path, UnicodeType &type, bool bUTF8, std::atomic_bo
             encoding = UTF8;
     }
 
+    if (keepBytes && ((encoding == UTF8) || (encoding == Ansi)))
+    {
+        // keep the bytes as they are: the text is only decoded on demand
+        hasBOM      = (encoding == UTF8) && (bytesRead > 2) && (pFileBuf[0] == 0xEF) && (pFileBuf[1] == 0xBB) && (pFileBuf[2] == 0xBF);
+        dataOffset  = hasBOM ? 3 : 0;
+        codePage    = (encoding == UTF8) ? CP_UTF8 : ansiCodePage;
+        rawLines    = true;
+        textDecoded = false;
+        textContent.clear();
+        type = encoding;
+        return CalculateLines(bCancelled);
+    }
+
     if (encoding == Unicode_Le)
     {
         try
@@ -290,53 +430,310 @@ bool CTextFile::Load(LPCWSTR path, UnicodeType &type, bool bUTF8, std::atomic_bo
     }
     else if ((encoding == UTF8) || ((encoding == Binary) && (bUTF8)))
     {
-        try
+        // decode directly into the text buffer, without the BOM
+        size_t bomLen = 0;
+        if ((bytesRead > 2) && (pFileBuf[0] == 0xEF) && (pFileBuf[1] == 0xBB) && (pFileBuf[2] == 0xBF))
         {
-            int  ret      = MultiByteToWideChar(CP_UTF8, 0, reinterpret_cast<LPCSTR>(pFileBuf.get()), bytesRead, nullptr, 0);
-            auto pWideBuf = std::make_unique<wchar_t[]>(ret + 1);
-            int  ret2     = MultiByteToWideChar(CP_UTF8, 0, reinterpret_cast<LPCSTR>(pFileBuf.get()), bytesRead, pWideBuf.get(), ret + 1);
-            if (ret2 == ret)
-            {
-                if ((ret > 1) && (*pWideBuf.get() == 0xFEFF))
-                {
-                    // remove the BOM
-                    textContent.assign(pWideBuf.get() + 1, ret - 1);
-                    hasBOM = true;
-                }
-                else
-                    textContent.assign(pWideBuf.get(), ret);
-            }
+            bomLen = 3;
+            hasBOM = true;
         }
-        catch (const std::exception &)
+        if (!DecodeText(pFileBuf.get() + bomLen, bytesRead - bomLen, UTF8, CP_UTF8, textContent))
+            return false;
+    }
+    else // if (encoding == ANSI)
+    {
+        codePage = ansiCodePage;
+        if (!DecodeText(pFileBuf.get(), bytesRead, Ansi, codePage, textContent))
+            return false;
+    }
+    if (textContent.capacity() > textCapacity)
+        CountAllocation((textContent.capacity() - textCapacity) * sizeof(wchar_t));
+    type = encoding;
+    if (type == Binary)
+        return true;
+    return CalculateLines(bCancelled);
+}
+
+bool CTextFile::LoadMapped(HANDLE hFile, DWORD size, UnicodeType &type, bool bUTF8, std::atomic_bool &bCancelled)
+{
+    if (!mappedFile.Map(hFile) || (mappedFile.GetSize() != size))
+    {
+        mappedFile.Close();
+        return false;
+    }
+    fileLen = size;
+
+    // only a sample is needed to detect the encoding, like when reading big files
+    const BYTE *pData = GetFileData();
+    encoding          = CheckUnicodeType(pData, static_cast<int>(min(size, encodingSampleSize)));
+    if ((bUTF8) && (encoding != Binary))
+        encoding = UTF8;
+
+    switch (encoding)
+    {
+        case Unicode_Le:
+            hasBOM = (size > 1) && (pData[0] == 0xFF) && (pData[1] == 0xFE);
+            break;
+        case Unicode_Be:
+            hasBOM = (size > 1) && (pData[0] == 0xFE) && (pData[1] == 0xFF);
+            break;
+        case UTF8:
+        case Binary:
+            hasBOM = ((encoding == UTF8) || bUTF8) && (size > 2) && (pData[0] == 0xEF) && (pData[1] == 0xBB) && (pData[2] == 0xBF);
+            break;
+        default:
+            hasBOM = false;
+            break;
+    }
+    dataOffset  = hasBOM ? ((encoding == Unicode_Le || encoding == Unicode_Be) ? 2 : 3) : 0;
+    codePage    = ((encoding == UTF8) || bUTF8) ? CP_UTF8 : ansiCodePage;
+    type        = encoding;
+    rawLines    = true;
+    textDecoded = false;
+    textContent.clear();
+    if (type == Binary)
+        return true;
+    return CalculateLines(bCancelled);
+}
+
+const BYTE *CTextFile::GetFileData() const
+{
+    if (!contentEncoded)
+    {
+        std::lock_guard<std::mutex> lock(lazyMutex);
+        if (!contentEncoded)
+            EncodeContent();
+    }
+    if (mappedFile.IsMapped())
+        return mappedFile.GetData();
+    return pFileBuf.get();
+}
+
+const std::wstring &CTextFile::GetFileString() const
+{
+    if (!textDecoded)
+    {
+        // DecodeRange() needs the encoded content, get it before locking
+        GetFileData();
+        std::lock_guard<std::mutex> lock(lazyMutex);
+        if (!textDecoded)
+        {
+            size_t unitSize = ((encoding == Unicode_Le) || (encoding == Unicode_Be)) ? sizeof(wchar_t) : 1;
+            textContent     = DecodeRange(0, (fileLen - dataOffset) / unitSize);
+            textDecoded     = true;
+        }
+    }
+    return textContent;
+}
+
+bool CTextFile::BuildPositionMap(const BYTE *pData, size_t len) const
+{
+    if (positionMapBuilt)
+        return true;
+    std::lock_guard<std::mutex> lock(lazyMutex);
+    if (!positionMapBuilt)
+        positionMapBuilt = positionMap.Build(reinterpret_cast<const char *>(pData), len);
+    return positionMapBuilt;
+}
+
+std::wstring CTextFile::DecodeRange(size_t startPos, size_t endPos) const
+{
+    const BYTE *pData = GetFileData();
+    if ((pData == nullptr) || (endPos <= startPos))
+        return {};
+    size_t       unitSize = ((encoding == Unicode_Le) || (encoding == Unicode_Be)) ? sizeof(wchar_t) : 1;
+    std::wstring result;
+    if (!DecodeText(pData + dataOffset + startPos * unitSize, (endPos - startPos) * unitSize, encoding, codePage, result))
+        return {};
+    return result;
+}
+
+size_t CTextFile::UTF16PositionFromPosition(size_t pos) const
+{
+    if (!rawLines || (encoding == Unicode_Le) || (encoding == Unicode_Be))
+        return pos;
+    const BYTE *pData = GetFileData();
+    if (pData == nullptr)
+        return 0;
+    pos = min(pos, static_cast<size_t>(fileLen - dataOffset));
+    if ((pos == 0) || CSingleByteCodePage::Get(codePage))
+        return pos;
+    if ((codePage == CP_UTF8) && BuildPositionMap(pData + dataOffset, fileLen - dataOffset))
+        return positionMap.UTF16FromUTF8(pos);
+    DWORD flags = (codePage == CP_UTF8) ? 0 : MB_PRECOMPOSED;
+    return MultiByteToWideChar(codePage, flags, reinterpret_cast<LPCSTR>(pData + dataOffset), static_cast<int>(pos), nullptr, 0);
+}
+
+size_t CTextFile::PositionFromUTF16Position(size_t pos) const
+{
+    if (!rawLines || (encoding == Unicode_Le) || (encoding == Unicode_Be))
+        return pos;
+    const BYTE *pData = GetFileData();
+    if (pData == nullptr)
+        return 0;
+    pData += dataOffset;
+    size_t len   = fileLen - dataOffset;
+    if (CSingleByteCodePage::Get(codePage))
+        return min(pos, len);
+    if ((codePage == CP_UTF8) && BuildPositionMap(pData, len))
+        return positionMap.UTF8FromUTF16(pos);
+    size_t i     = 0;
+    size_t units = 0;
+    while ((i < len) && (units < pos))
+    {
+        if (codePage == CP_UTF8)
+        {
+            // decode like MultiByteToWideChar does so that invalid sequences count the same
+            units += (UTFTranscoder::DecodeUTF8(pData, len, i) >= 0x10000) ? 2 : 1;
+        }
+        else
         {
+            ++units;
+            i += ((i + 1 < len) && IsDBCSLeadByte(pData[i])) ? 2 : 1;
+        }
+    }
+    return i;
+}
+
+void CTextFile::SetFileContent(const std::wstring &content)
+{
+    mappedFile.Close();
+    positionMap.Clear();
+    positionMapBuilt = false;
+    rawLines    = false;
+    textDecoded = true;
+    dataOffset  = 0;
+    textContent = content;
+    EncodeContent();
+    if (!pFileBuf)
+        textContent = L"";
+}
+
+bool CTextFile::ReplaceRange(size_t startPos, size_t endPos, const std::wstring &text)
+{
+    if (rawLines)
+    {
+        // switch to the decoded text: positions are UTF16 positions from now on
+        const BYTE *pData = GetFileData();
+        if (pData == nullptr)
             return false;
+        GetFileString();
+        if (mappedFile.IsMapped())
+        {
+            // keep a copy of the file content to modify
+            if (!ReserveFileBuf(fileLen))
+                return false;
+            memcpy(pFileBuf.get(), pData, fileLen);
+            mappedFile.Close();
         }
+        positionMap.Clear();
+        positionMapBuilt = false;
+        rawLines   = false;
+        dataOffset = 0;
+        std::atomic_bool notCancelled = false;
+        if (!CalculateLines(notCancelled))
+            return false;
     }
-    else // if (encoding == ANSI)
+
+    const size_t oldSize = textContent.size();
+    if ((startPos > endPos) || (endPos > oldSize))
+        return false;
+    if (!compactLines.empty())
     {
+        // edits need the plain line positions
         try
         {
-            int  ret      = MultiByteToWideChar(CP_ACP, MB_PRECOMPOSED, reinterpret_cast<LPCSTR>(pFileBuf.get()), bytesRead, nullptr, 0);
-            auto pWideBuf = std::make_unique<wchar_t[]>(ret + 1);
-            int  ret2     = MultiByteToWideChar(CP_ACP, MB_PRECOMPOSED, reinterpret_cast<LPCSTR>(pFileBuf.get()), bytesRead, pWideBuf.get(), ret + 1);
-            if (ret2 == ret)
-                textContent.assign(pWideBuf.get(), ret);
+            compactLines.Expand(linePositions);
         }
         catch (const std::exception &)
         {
             return false;
         }
+        compactLines.Clear();
     }
-    type = encoding;
-    if (type == Binary)
-        return true;
-    return CalculateLines(bCancelled);
+    const size_t newEnd = startPos + text.size();
+
+    // update the encoded content: utf16-le is changed in place,
+    // everything else is encoded again when needed.
+    if ((encoding == Unicode_Le) && contentEncoded && !mappedFile.IsMapped() && pFileBuf)
+    {
+        size_t bomLen   = hasBOM ? sizeof(wchar_t) : 0;
+        size_t newLen   = bomLen + (oldSize - (endPos - startPos) + text.size()) * sizeof(wchar_t);
+        BYTE  *pOldTail = pFileBuf.get() + bomLen + endPos * sizeof(wchar_t);
+        size_t tailLen  = (oldSize - endPos) * sizeof(wchar_t);
+        if (newLen > MAXDWORD)
+            return false;
+        if (newLen > fileBufSize)
+        {
+            // grow the buffer with some room for further edits
+            size_t newSize = min(newLen + newLen / 4, static_cast<size_t>(MAXDWORD));
+            try
+            {
+                auto pNewBuf = std::make_unique<BYTE[]>(newSize);
+                memcpy(pNewBuf.get(), pFileBuf.get(), bomLen + startPos * sizeof(wchar_t));
+                memcpy(pNewBuf.get() + bomLen + newEnd * sizeof(wchar_t), pOldTail, tailLen);
+                pFileBuf    = std::move(pNewBuf);
+                fileBufSize = static_cast<DWORD>(newSize);
+                CountAllocation(newSize);
+            }
+            catch (const std::exception &)
+            {
+                return false;
+            }
+        }
+        else
+            memmove(pFileBuf.get() + bomLen + newEnd * sizeof(wchar_t), pOldTail, tailLen);
+        memcpy(pFileBuf.get() + bomLen + startPos * sizeof(wchar_t), text.c_str(), text.size() * sizeof(wchar_t));
+        fileLen = static_cast<DWORD>(newLen);
+    }
+    else
+    {
+        mappedFile.Close();
+        contentEncoded = false;
+    }
+
+    try
+    {
+        textContent.replace(startPos, endPos - startPos, text);
+
+        // the synthetic line end for the last line is added again below
+        if (!linePositions.empty() && (linePositions.back() == oldSize))
+            linePositions.pop_back();
+
+        // the line ends inside the replaced range are gone. A cr right before
+        // the range might have become a lone cr or part of a crlf.
+        size_t scanStart = (startPos > 0) ? startPos - 1 : 0;
+        auto   first     = std::distance(linePositions.cbegin(), sortedLowerBound(linePositions.cbegin(), linePositions.cend(), scanStart));
+        auto   last      = std::distance(linePositions.cbegin(), sortedLowerBound(linePositions.cbegin() + first, linePositions.cend(), endPos));
+        // the line ends after the range only move
+        ptrdiff_t delta  = static_cast<ptrdiff_t>(text.size()) - static_cast<ptrdiff_t>(endPos - startPos);
+        for (auto it = linePositions.begin() + last; it != linePositions.end(); ++it)
+            *it += delta;
+        std::vector<size_t> newEnds;
+        for (size_t pos = scanStart; pos < newEnd; ++pos)
+        {
+            if ((textContent[pos] == L'\r') || (textContent[pos] == L'\n'))
+                CLineScanner::AddLineEnd<wchar_t>(textContent.c_str(), pos, textContent.size(), L'\n', newEnds);
+        }
+        linePositions.erase(linePositions.begin() + first, linePositions.begin() + last);
+        linePositions.insert(linePositions.begin() + first, newEnds.begin(), newEnds.end());
+
+        if (!textContent.empty() && (textContent.back() != L'\r') && (textContent.back() != L'\n'))
+            linePositions.push_back(textContent.size());
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+    return true;
 }
 
-void CTextFile::SetFileContent(const std::wstring &content)
+void CTextFile::EncodeContent() const
 {
-    pFileBuf = nullptr;
-    fileLen  = 0;
+    // encode the text content with the encoding of the file
+    const std::wstring &content = textContent;
+    pFileBuf                    = nullptr;
+    fileLen                     = 0;
 
     try
     {
@@ -428,13 +825,18 @@ void CTextFile::SetFileContent(const std::wstring &content)
                 }
             }
         }
+        else if (const auto *pSingleByte = CSingleByteCodePage::Get(ansiCodePage); pSingleByte && ((encoding == Ansi) || (encoding == Binary)))
+        {
+            pFileBuf = std::make_unique<BYTE[]>(content.size() + 1);
+            fileLen  = static_cast<DWORD>(pSingleByte->FromWide(content.c_str(), content.size(), reinterpret_cast<char *>(pFileBuf.get())));
+        }
         else if ((encoding == Ansi) || (encoding == Binary))
         {
-            int ret  = WideCharToMultiByte(CP_ACP, 0, content.c_str(), static_cast<int>(content.size()) + 1, nullptr, 0, nullptr, nullptr);
+            int ret  = WideCharToMultiByte(ansiCodePage, 0, content.c_str(), static_cast<int>(content.size()) + 1, nullptr, 0, nullptr, nullptr);
             pFileBuf = std::make_unique<BYTE[]>(ret);
             if (pFileBuf)
             {
-                int ret2 = WideCharToMultiByte(CP_ACP, 0, content.c_str(), static_cast<int>(content.size()) + 1, reinterpret_cast<LPSTR>(pFileBuf.get()), ret, nullptr, nullptr);
+                int ret2 = WideCharToMultiByte(ansiCodePage, 0, content.c_str(), static_cast<int>(content.size()) + 1, reinterpret_cast<LPSTR>(pFileBuf.get()), ret, nullptr, nullptr);
                 fileLen  = ret2 - 1;
                 if (ret2 != ret)
                 {
@@ -447,154 +849,185 @@ void CTextFile::SetFileContent(const std::wstring &content)
     catch (const std::exception &)
     {
     }
+    fileBufSize = pFileBuf ? fileLen : 0;
     if (pFileBuf)
-        textContent = content;
-    else
-        textContent = L"";
+        CountAllocation(fileLen);
+    // set last: GetFileData() only locks while this is false
+    contentEncoded = true;
 }
 
 bool CTextFile::ContentsModified(std::unique_ptr<BYTE[]> pBuf, DWORD newLen)
 {
-    pFileBuf = std::move(pBuf);
-    fileLen  = newLen;
+    mappedFile.Close();
+    pFileBuf       = std::move(pBuf);
+    fileBufSize    = newLen;
+    fileLen        = newLen;
+    contentEncoded = true;
     return true;
 }
 
-CTextFile::UnicodeType CTextFile::CheckUnicodeType(BYTE *pBuffer, int cb) const
+CTextFile::UnicodeType CTextFile::DetectEncoding(const BYTE *pBuffer, int cb, int nullByteCount)
 {
     if (cb < 2)
         return Ansi;
-    UINT16 *pVal16   = reinterpret_cast<UINT16 *>(pBuffer);
-    UINT8  *pVal8    = reinterpret_cast<UINT8 *>(pVal16 + 1);
-    // scan the whole buffer for a 0x0000 sequence
-    // if found, we assume a binary file
-    int     nNull    = 0;
-    int     nDblNull = 0;
-    for (int i = 0; i < (cb - 2); i = i + 2)
-    {
-        if (0x0000 == *pVal16++)
-            ++nDblNull;
-        if (0x00 == *pVal8++)
-            ++nNull;
-        if (0x00 == *pVal8++)
-            ++nNull;
-    }
+    TextBufferStats stats;
+    ScanTextBuffer(pBuffer, cb, cb / 50, stats);
+
+    // a 0x0000 sequence means a binary file. The last word is not counted.
+    int nDblNull = stats.nullWords;
+    if (((cb % 2) == 0) && (pBuffer[cb - 2] == 0) && (pBuffer[cb - 1] == 0))
+        --nDblNull;
     if (nDblNull > nullByteCount) // configured value: allow double null chars to account for 'broken' text files
         return Binary;
-    pVal16 = reinterpret_cast<UINT16 *>(pBuffer);
-    pVal8  = reinterpret_cast<UINT8 *>(pVal16 + 1);
-    if (*pVal16 == 0xFEFF)
+    if ((pBuffer[0] == 0xFF) && (pBuffer[1] == 0xFE))
         return Unicode_Le;
-    if (*pVal16 == 0xFFFE)
+    if ((pBuffer[0] == 0xFE) && (pBuffer[1] == 0xFF))
         return Unicode_Be;
+    // null chars, not counting the first word
+    int nNull = stats.nullBytes - (pBuffer[0] == 0) - (pBuffer[1] == 0);
     if ((nNull > 3) && ((cb % 2) == 0)) // arbitrary value: allow three null chars to account for 'broken' ANSI/UTF8 text files, otherwise consider the file UTF16-LE
         return Unicode_Le;
     if (cb < 3)
         return Ansi;
-    if (*pVal16 == 0xBBEF)
-    {
-        if (*pVal8 == 0xBF)
-            return UTF8;
-    }
-    // check for illegal UTF8 chars
-    pVal8 = static_cast<UINT8 *>(pBuffer);
-    for (int i = 0; i < cb; ++i)
+    if ((pBuffer[0] == 0xEF) && (pBuffer[1] == 0xBB) && (pBuffer[2] == 0xBF))
+        return UTF8;
+    // check for illegal UTF8 chars and sequences
+    if (stats.illegalUTF8Bytes || stats.laxUTF8Error)
+        return Ansi;
+    if (stats.laxUTF8Found)
+        return UTF8;
+    return Ansi;
+}
+
+bool CTextFile::CalculateLines(std::atomic_bool &bCancelled)
+{
+    // fill an array with starting positions for every line in the loaded file
+    const BYTE *pData = GetFileData();
+    if (pData == nullptr)
+        return false;
+    size_t capacity = linePositions.capacity();
+    bool   ret      = true;
+    compactLines.Clear();
+    if (!rawLines)
     {
-        if ((*pVal8 == 0xC0) || (*pVal8 == 0xC1) || (*pVal8 >= 0xF5))
-            return Ansi;
-        pVal8++;
+        if (textContent.empty())
+            return true;
+        linePositions.clear();
+        linePositions.reserve(textContent.size() / 10);
+        ret = CLineScanner::FindLineEnds<wchar_t>(textContent.c_str(), textContent.size(), L'\r', L'\n', linePositions, bCancelled);
     }
-    pVal8      = static_cast<UINT8 *>(pBuffer);
-    bool bUTF8 = false;
-    for (int i = 0; i < (cb - 4); ++i)
+    else
     {
-        if ((*pVal8 & 0xE0) == 0xC0)
-        {
-            pVal8++;
-            i++;
-            if ((*pVal8 & 0xC0) != 0x80)
-                return Ansi;
-            bUTF8 = true;
-        }
-        if ((*pVal8 & 0xF0) == 0xE0)
-        {
-            pVal8++;
-            i++;
-            if ((*pVal8 & 0xC0) != 0x80)
-                return Ansi;
-            pVal8++;
-            i++;
-            if ((*pVal8 & 0xC0) != 0x80)
-                return Ansi;
-            bUTF8 = true;
-        }
-        if ((*pVal8 & 0xF8) == 0xF0)
+        // no decoded text available: scan the raw file content
+        pData += dataOffset;
+        size_t dataLen = fileLen - dataOffset;
+        if (dataLen == 0)
+            return true;
+        linePositions.clear();
+        switch (encoding)
         {
-            pVal8++;
-            i++;
-            if ((*pVal8 & 0xC0) != 0x80)
-                return Ansi;
-            pVal8++;
-            i++;
-            if ((*pVal8 & 0xC0) != 0x80)
-                return Ansi;
-            pVal8++;
-            i++;
-            if ((*pVal8 & 0xC0) != 0x80)
-                return Ansi;
-            bUTF8 = true;
+            case Unicode_Le:
+                linePositions.reserve(dataLen / sizeof(wchar_t) / 10);
+                ret = CLineScanner::FindLineEnds<UINT16>(reinterpret_cast<const UINT16 *>(pData), dataLen / sizeof(wchar_t), 0x000D, 0x000A, linePositions, bCancelled);
+                break;
+            case Unicode_Be:
+                linePositions.reserve(dataLen / sizeof(wchar_t) / 10);
+                ret = CLineScanner::FindLineEnds<UINT16>(reinterpret_cast<const UINT16 *>(pData), dataLen / sizeof(wchar_t), 0x0D00, 0x0A00, linePositions, bCancelled);
+                break;
+            default:
+                linePositions.reserve(dataLen / 10);
+                ret = CLineScanner::FindLineEnds<char>(reinterpret_cast<const char *>(pData), dataLen, '\r', '\n', linePositions, bCancelled);
+                break;
         }
-        pVal8++;
     }
-    if (bUTF8)
-        return UTF8;
-    return Ansi;
+    if (linePositions.capacity() > capacity)
+        CountAllocation((linePositions.capacity() - capacity) * sizeof(size_t));
+    // keep the capacity: the next Load() reuses it for scanning
+    if (ret && useCompactIndex && compactLines.Build(linePositions))
+        linePositions.clear();
+    return ret;
 }
 
-bool CTextFile::CalculateLines(std::atomic_bool &bCancelled)
+size_t CTextFile::GetLineCount() const
 {
-    // fill an array with starting positions for every line in the loaded file
-    if (pFileBuf == nullptr)
+    return compactLines.empty() ? linePositions.size() : compactLines.size();
+}
+
+size_t CTextFile::GetLineEnd(size_t index) const
+{
+    return compactLines.empty() ? linePositions[index] : compactLines[index];
+}
+
+size_t CTextFile::FindLineEnd(size_t index, size_t pos) const
+{
+    if (!compactLines.empty())
+        return compactLines.LowerBound(pos);
+    return std::distance(linePositions.cbegin(), sortedLowerBound(linePositions.cbegin() + index, linePositions.cend(), pos));
+}
+
+bool CTextFile::ResolvePositions(const size_t *positions, size_t count, std::vector<LinePosition> &result) const
+{
+    try
+    {
+        result.clear();
+        result.reserve(count);
+    }
+    catch (const std::exception &)
+    {
         return false;
-    if (textContent.empty())
-        return true;
-    linePositions.clear();
-    linePositions.reserve(textContent.size() / 10);
-    size_t pos  = 0;
-    bool   bGot = false;
-    for (auto it = textContent.begin(); it != textContent.end() && !bCancelled; ++it)
+    }
+
+    // walk the line endings along with the positions. If a position
+    // is many lines ahead, jump there with a binary search instead.
+    constexpr int maxSteps  = 8;
+    const size_t  lineCount = GetLineCount();
+    size_t        index     = 0; // zero based index of the line the current position is in
+    size_t        lineStart = 0;
+    size_t        lineEnd   = lineCount ? GetLineEnd(0) : 0;
+    size_t        lastPos   = 0;
+    for (size_t i = 0; i < count; ++i)
     {
-        bGot = false;
-        if (*it == '\r')
+        size_t pos = positions[i];
+        if (pos < lastPos)
         {
-            // cr lineending
-            bGot = true;
-            if (it + 1 < textContent.end())
-            {
-                if (it[1] == '\n')
-                {
-                    // crlf lineending
-                    ++it;
-                    ++pos;
-                }
-            }
+            // not sorted: start over
+            index     = 0;
+            lineStart = 0;
+            lineEnd   = lineCount ? GetLineEnd(0) : 0;
         }
-        else if (*it == '\n')
+        lastPos = pos;
+
+        int steps = 0;
+        while ((index < lineCount) && (lineEnd < pos))
         {
-            // lf lineending
-            bGot = true;
+            if (++steps > maxSteps)
+            {
+                index     = FindLineEnd(index, pos);
+                lineStart = GetLineEnd(index - 1) + 1;
+                if (index < lineCount)
+                    lineEnd = GetLineEnd(index);
+                break;
+            }
+            lineStart = lineEnd + 1;
+            ++index;
+            if (index < lineCount)
+                lineEnd = compactLines.empty() ? linePositions[index] : compactLines.Next(index - 1, lineEnd);
         }
-        if (bGot)
-            linePositions.push_back(pos);
-        ++pos;
+
+        LinePosition lp;
+        lp.line      = static_cast<long>(index + 1);
+        lp.column    = static_cast<long>(pos - lineStart + 1);
+        lp.lineStart = lineStart;
+        lp.lineEnd   = (index < lineCount) ? lineEnd : pos;
+        result.push_back(lp);
     }
-    if (!bGot)
-        linePositions.push_back(pos);
     return true;
 }
 
 long CTextFile::LineFromPosition(long pos) const
 {
+    if (!compactLines.empty())
+        return static_cast<long>(compactLines.LowerBound(static_cast<size_t>(pos)) + 1);
     auto lb     = sortedLowerBound(linePositions.cbegin(), linePositions.cend(), static_cast<size_t>(pos));
     auto lbLine = std::distance(linePositions.begin(), lb);
     return static_cast<long>(lbLine + 1);
@@ -606,22 +1039,24 @@ long CTextFile::ColumnFromPosition(long pos, long line) const
         line = LineFromPosition(pos);
     long lastLineEnd = -1;
     if (line > 1)
-        lastLineEnd = static_cast<long>(linePositions[line - 2]);
+        lastLineEnd = static_cast<long>(GetLineEnd(line - 2));
     return pos - lastLineEnd;
 }
 
 std::wstring CTextFile::GetLineString(long lineNumber) const
 {
-    if ((lineNumber <= 0) || (lineNumber > static_cast<long>(linePositions.size())))
+    if ((lineNumber <= 0) || (lineNumber > static_cast<long>(GetLineCount())))
         return std::wstring();
 
     size_t startPos = 0;
-    size_t endPos   = linePositions[lineNumber - 1];
+    size_t endPos   = GetLineEnd(lineNumber - 1);
     if (lineNumber > 1)
-        startPos = linePositions[lineNumber - 2] + 1;
-    if (lineNumber < static_cast<long>(linePositions.size()))
+        startPos = GetLineEnd(lineNumber - 2) + 1;
+    if (lineNumber < static_cast<long>(GetLineCount()))
         endPos++;
 
+    if (rawLines)
+        return DecodeRange(startPos, endPos);
     return std::wstring(textContent.begin() + startPos, textContent.begin() + endPos);
 }
 
@@ -654,3 +1089,271 @@ std::wstring CTextFile::GetFileNameExtension() const
 {
     return CPathUtils::GetFileExtension(filename);
 }
+
+CTextFileReader::CTextFileReader(size_t windowSize)
+    : windowSize(max(windowSize, static_cast<size_t>(64)))
+    , rawLen(0)
+    , fileLen(0)
+    , readOffset(0)
+    , windowOffset(0)
+    , windowLine(1)
+    , nextLine(1)
+    , eof(false)
+    , hasBOM(false)
+    , nullByteCount(2)
+    , codePage(CP_ACP)
+    , ansiCodePage(CP_ACP)
+    , encoding(CTextFile::AutoType)
+{
+}
+
+CTextFileReader::~CTextFileReader()
+{
+}
+
+bool CTextFileReader::Open(LPCWSTR path, CTextFile::UnicodeType &type, bool bUTF8)
+{
+    type         = CTextFile::AutoType;
+    encoding     = CTextFile::AutoType;
+    rawLen       = 0;
+    fileLen      = 0;
+    readOffset   = 0;
+    windowOffset = 0;
+    windowLine   = 1;
+    nextLine     = 1;
+    eof          = false;
+    hasBOM       = false;
+    windowText.clear();
+    linePositions.clear();
+    rawLinePositions.clear();
+
+    hFile = OpenFileForReading(path);
+    if (!hFile)
+        return false;
+    LARGE_INTEGER lint;
+    if (!GetFileSizeEx(hFile, &lint))
+        return false;
+    fileLen = lint.QuadPart;
+    try
+    {
+        if (rawBuf == nullptr)
+            rawBuf = std::make_unique<BYTE[]>(windowSize);
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+    if (!FillBuffer())
+        return false;
+
+    BYTE *pRaw = rawBuf.get();
+    encoding   = CTextFile::DetectEncoding(pRaw, static_cast<int>(rawLen), nullByteCount);
+    if ((bUTF8) && (encoding != CTextFile::Binary))
+        encoding = CTextFile::UTF8;
+
+    size_t bomLen = 0;
+    switch (encoding)
+    {
+        case CTextFile::Unicode_Le:
+            if ((rawLen > 1) && (pRaw[0] == 0xFF) && (pRaw[1] == 0xFE))
+                bomLen = 2;
+            break;
+        case CTextFile::Unicode_Be:
+            if ((rawLen > 1) && (pRaw[0] == 0xFE) && (pRaw[1] == 0xFF))
+                bomLen = 2;
+            break;
+        case CTextFile::UTF8:
+        case CTextFile::Binary:
+            if (((encoding == CTextFile::UTF8) || bUTF8) && (rawLen > 2) && (pRaw[0] == 0xEF) && (pRaw[1] == 0xBB) && (pRaw[2] == 0xBF))
+                bomLen = 3;
+            break;
+        default:
+            break;
+    }
+    if (bomLen)
+    {
+        hasBOM = true;
+        memmove(pRaw, pRaw + bomLen, rawLen - bomLen);
+        rawLen -= bomLen;
+        readOffset = bomLen;
+    }
+    codePage = ((encoding == CTextFile::UTF8) || bUTF8) ? CP_UTF8 : ansiCodePage;
+    type     = encoding;
+    utf8Validator.Reset(readOffset);
+    return true;
+}
+
+bool CTextFileReader::FillBuffer()
+{
+    while (!eof && (rawLen < windowSize))
+    {
+        DWORD bytesRead   = 0;
+        DWORD bytesToRead = static_cast<DWORD>(min(windowSize - rawLen, static_cast<size_t>(0x40000000)));
+        if (!ReadFile(hFile, rawBuf.get() + rawLen, bytesToRead, &bytesRead, nullptr))
+            return false;
+        if (bytesRead == 0)
+            eof = true;
+        rawLen += bytesRead;
+    }
+    return true;
+}
+
+size_t CTextFileReader::FindWindowEnd() const
+{
+    if (eof)
+        return rawLen;
+
+    // end the window after the last lineending in the buffer.
+    // A cr at the very end is not used since the lf of a crlf
+    // might not have been read yet: it is carried over to the next window.
+    const BYTE *pRaw = rawBuf.get();
+    if ((encoding == CTextFile::Unicode_Le) || (encoding == CTextFile::Unicode_Be))
+    {
+        size_t units = rawLen / sizeof(wchar_t);
+        auto   unit  = [&](size_t i) -> UINT16 {
+            if (encoding == CTextFile::Unicode_Le)
+                return static_cast<UINT16>(pRaw[i * 2] | (pRaw[i * 2 + 1] << 8));
+            return static_cast<UINT16>((pRaw[i * 2] << 8) | pRaw[i * 2 + 1]);
+        };
+        if ((units > 1) && (unit(units - 1) == '\r'))
+            --units;
+        for (size_t i = units; i > 0; --i)
+        {
+            if ((unit(i - 1) == '\n') || (unit(i - 1) == '\r'))
+                return i * sizeof(wchar_t);
+        }
+        // the line does not fit into the window: split it, but
+        // don't split a surrogate pair
+        if ((units > 1) && (unit(units - 1) >= 0xD800) && (unit(units - 1) < 0xDC00))
+            return (units - 1) * sizeof(wchar_t);
+        return units * sizeof(wchar_t);
+    }
+
+    size_t len = rawLen;
+    if ((len > 1) && (pRaw[len - 1] == '\r'))
+        --len;
+    for (size_t i = len; i > 0; --i)
+    {
+        if ((pRaw[i - 1] == '\n') || (pRaw[i - 1] == '\r'))
+            return i;
+    }
+    // the line does not fit into the window: split it, but
+    // carry an incomplete UTF8 sequence over to the next window
+    if ((codePage == CP_UTF8) && (len > 0))
+    {
+        size_t lead = len - 1;
+        while ((lead > 0) && (len - lead < 4) && UTF8Helper::isContinuation(pRaw[lead]))
+            --lead;
+        if ((lead > 0) && UTF8Helper::isFirstOfMultibyte(pRaw[lead]) && (lead + UTF8Helper::continuationBytes(pRaw[lead]) >= len))
+            return lead;
+    }
+    return len;
+}
+
+bool CTextFileReader::ReadWindow(std::atomic_bool &bCancelled)
+{
+    windowText.clear();
+    linePositions.clear();
+    rawLinePositions.clear();
+    windowPositions.Clear();
+    windowRaw.clear();
+    if ((rawBuf == nullptr) || bCancelled)
+        return false;
+    if (!FillBuffer())
+        return false;
+
+    const bool utf16 = (encoding == CTextFile::Unicode_Le) || (encoding == CTextFile::Unicode_Be);
+    BYTE      *pRaw     = rawBuf.get();
+    if (rawLen == 0)
+        return false;
+
+    size_t windowEnd = FindWindowEnd();
+    windowOffset     = readOffset;
+    windowLine       = nextLine;
+    if (!DecodeText(pRaw, windowEnd, encoding, codePage, windowText))
+        return false;
+    if (encoding == CTextFile::UTF8)
+    {
+        utf8Validator.Feed(pRaw, windowEnd);
+        // rawBuf is reused for the next window, so keep a copy of the
+        // bytes for the position map
+        windowRaw.assign(reinterpret_cast<const char *>(pRaw), windowEnd);
+        windowPositions.Build(windowRaw.c_str(), windowRaw.size());
+    }
+
+    try
+    {
+        std::atomic_bool notCancelled = false;
+        if (!windowText.empty() && !CLineScanner::FindLineEnds<wchar_t>(windowText.c_str(), windowText.size(), L'\r', L'\n', linePositions, notCancelled))
+            return false;
+        if (!utf16 && !CLineScanner::FindLineEnds<char>(reinterpret_cast<const char *>(pRaw), windowEnd, '\r', '\n', rawLinePositions, notCancelled))
+            return false;
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+    size_t lineEnds = linePositions.size();
+    if (!windowText.empty() && (windowText.back() != L'\r') && (windowText.back() != L'\n'))
+        --lineEnds; // the last line continues in the next window
+    nextLine += lineEnds;
+
+    // carry the rest over to the next window
+    memmove(pRaw, pRaw + windowEnd, rawLen - windowEnd);
+    rawLen -= windowEnd;
+    readOffset += windowEnd;
+    if ((encoding == CTextFile::UTF8) && eof && (rawLen == 0))
+        utf8Validator.Finish();
+    return true;
+}
+
+UINT64 CTextFileReader::LineFromPosition(size_t pos) const
+{
+    auto lb = sortedLowerBound(linePositions.cbegin(), linePositions.cend(), pos);
+    return windowLine + std::distance(linePositions.cbegin(), lb);
+}
+
+UINT64 CTextFileReader::OffsetFromPosition(size_t pos) const
+{
+    if ((encoding == CTextFile::Unicode_Le) || (encoding == CTextFile::Unicode_Be))
+        return windowOffset + pos * sizeof(wchar_t);
+    if (CSingleByteCodePage::Get(codePage))
+        return windowOffset + min(pos, windowText.size());
+    if (encoding == CTextFile::UTF8)
+    {
+        // converting the text back would not give the original length
+        // of invalid sequences
+        return windowOffset + windowPositions.UTF8FromUTF16(min(pos, windowText.size()));
+    }
+
+    // the lineendings in the raw data match the ones in the decoded text:
+    // start at the line start and only convert the rest of the line back
+    auto   lb        = sortedLowerBound(linePositions.cbegin(), linePositions.cend(), pos);
+    size_t line      = std::distance(linePositions.cbegin(), lb);
+    size_t lineStart = 0;
+    UINT64 offset    = windowOffset;
+    if ((line > 0) && (line <= rawLinePositions.size()))
+    {
+        lineStart = linePositions[line - 1] + 1;
+        offset += rawLinePositions[line - 1] + 1;
+    }
+    if (pos > lineStart)
+        offset += WideCharToMultiByte(codePage, 0, windowText.c_str() + lineStart, static_cast<int>(min(pos, windowText.size()) - lineStart), nullptr, 0, nullptr, nullptr);
+    return offset;
+}
+
+std::wstring CTextFileReader::GetLineString(UINT64 lineNumber) const
+{
+    if ((lineNumber < windowLine) || (lineNumber >= windowLine + linePositions.size()))
+        return std::wstring();
+
+    size_t index    = static_cast<size_t>(lineNumber - windowLine);
+    size_t startPos = 0;
+    size_t endPos   = linePositions[index];
+    if (index > 0)
+        startPos = linePositions[index - 1] + 1;
+    if (index + 1 < linePositions.size())
+        endPos++;
+
+    return std::wstring(windowText.begin() + startPos, windowText.begin() + endPos);
+}
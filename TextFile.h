@@ -1,6 +1,6 @@
 // sktoolslib - common files for SK tools
 
-// Copyright (C) 2012, 2017-2023 - Stefan Kueng
+// Copyright (C) 2012, 2017-2023, 2026 - Stefan Kueng
 
 // This program is free software; you can redistribute it and/or
 // modify it under the terms of the GNU General Public License
@@ -19,9 +19,16 @@
 
 #pragma once
 
+#include "SmartHandle.h"
+#include "LineIndex.h"
+#include "MappedFile.h"
+#include "UTF8PositionMap.h"
+#include "UTF8Validator.h"
+#include <atomic>
 #include <string>
 #include <vector>
 #include <memory>
+#include <mutex>
 
 /**
  * handles text files.
@@ -42,11 +49,47 @@ public:
         UTF8
     };
 
+    /// counters for the heap allocations done by all CTextFile objects
+    struct AllocationCounters
+    {
+        UINT64 count;
+        UINT64 bytes;
+    };
+
+    /// line information for a position, see ResolvePositions()
+    struct LinePosition
+    {
+        long   line;      ///< same as LineFromPosition()
+        long   column;    ///< same as ColumnFromPosition()
+        size_t lineStart; ///< position of the first char of the line
+        size_t lineEnd;   ///< position of the line ending, or the position itself if it's after the last line
+    };
+
     /**
      * Loads a file from the specified \c path.
+     * \note the memory used for the previously loaded file is reused
+     *       if it is big enough, see Reset().
+     * \note files bigger than 4GB are not loaded: only their encoding is
+     *       detected and returned in \c type. Use CTextFileReader to
+     *       process such files.
      */
     bool                Load(LPCWSTR path, UnicodeType& type, bool bUTF8, std::atomic_bool& bCancelled);
 
+    /**
+     * Clears the file content, but keeps the allocated buffers so that
+     * the object can be reused for the next file without allocating
+     * memory again. Load() calls this, so it's only needed to
+     * release the content early.
+     */
+    void                Reset();
+
+    /**
+     * Returns the number and size of the heap allocations done for file
+     * buffers, decoded texts and line information by all CTextFile objects.
+     */
+    static AllocationCounters GetAllocationCounters();
+    static void               ResetAllocationCounters();
+
     /**
      * Saves the file contents to disk at \c path.
      */
@@ -63,15 +106,44 @@ public:
 
     /**
      * Returns the line number from a given character position inside the file.
+     * \note if the file was loaded without decoding it (see SetMemoryMapping()
+     *       and SetKeepBytes()), the position is in code units of the raw file
+     *       content instead: bytes for UTF8 and ANSI files, wchar_t for UTF16 files.
      */
     long                LineFromPosition(long pos) const;
 
     /**
      * Returns the column number from a given character position inside the file.
      * \if param line is -1, that means it has not been calculated.
+     * \note like LineFromPosition(), the position and the column are in raw
+     *       code units if the file was loaded without decoding it.
      */
     long                ColumnFromPosition(long pos, long line) const;
 
+    /**
+     * Converts a position in the raw file content to the position in the
+     * UTF16 text returned by GetFileString().
+     * If the file content was decoded on load, the position is returned as is.
+     * For UTF8 content, the first call builds a position map so that
+     * further calls only scan a small part of the content.
+     */
+    size_t              UTF16PositionFromPosition(size_t pos) const;
+
+    /**
+     * Converts a position in the UTF16 text returned by GetFileString()
+     * to the position in the raw file content.
+     * If the file content was decoded on load, the position is returned as is.
+     */
+    size_t              PositionFromUTF16Position(size_t pos) const;
+
+    /**
+     * Resolves the line information for \c count positions at once.
+     * If the positions are sorted, this walks the line information only
+     * once instead of searching it for every position.
+     * \param result receives one entry for every position
+     */
+    bool                ResolvePositions(const size_t* positions, size_t count, std::vector<LinePosition>& result) const;
+
     /**
      * Returns the line from a given line number
      */
@@ -80,19 +152,26 @@ public:
     /**
      * Returns the file content as a text string.
      * \note the text string can not be modified and is to be treated read-only.
+     * \note if the file is memory mapped, the whole file gets decoded on the
+     *       first call. Use GetLineString() to decode only parts of the file.
      */
-    const std::wstring& GetFileString() const { return textContent; }
+    const std::wstring& GetFileString() const;
 
     /**
      * Returns a pointer to the file contents. Call GetFileLength() to get
      * the size in number of bytes of this buffer.
+     * \note if the file is memory mapped, the buffer is read-only.
      */
-    LPVOID              GetFileContent() const { return pFileBuf.get(); }
+    LPVOID              GetFileContent() const { return const_cast<BYTE*>(GetFileData()); }
 
     /**
      * Returns the size of the file in bytes
      */
-    long                GetFileLength() const { return fileLen; }
+    long                GetFileLength() const
+    {
+        GetFileData();
+        return fileLen;
+    }
 
     /**
      * Returns the encoding of the file
@@ -124,6 +203,17 @@ public:
      */
     void                SetFileContent(const std::wstring& content);
 
+    /**
+     * Replaces the text between the positions \c startPos and \c endPos
+     * with \c text. The line information is updated for the changed
+     * part only, UTF16-LE content is changed in place and all other
+     * encodings are encoded again the next time the file content is needed.
+     * \note if the file was loaded without decoding it, the text gets
+     *       decoded first: \c startPos and \c endPos are always positions
+     *       in the text returned by GetFileString().
+     */
+    bool                ReplaceRange(size_t startPos, size_t endPos, const std::wstring& text);
+
     bool                HasBOM() const { return hasBOM; }
 
     /**
@@ -133,11 +223,60 @@ public:
      */
     void                SetNullbyteCountForBinary(int count) { nullByteCount = count; }
 
+    /**
+     * If set, Load() maps the file read-only into memory instead of reading
+     * it into a buffer, and the mapped bytes stay the source of truth:
+     * nothing gets decoded to UTF16 until GetLineString() or GetFileString()
+     * are called. The line information then refers to positions in the raw
+     * file content, see LineFromPosition().
+     * The const accessors decode the text and build the position map on
+     * first use; this is guarded, so a const object can still be read
+     * from several threads at once.
+     * Default is false.
+     */
+    void                SetMemoryMapping(bool map) { useMapping = map; }
+
+    /**
+     * If set, Load() keeps UTF8 and ANSI files in their original encoding
+     * instead of converting them to UTF16: the line information is built from
+     * byte positions, and the text is only decoded when GetLineString()
+     * or GetFileString() are called. Use UTF16PositionFromPosition() to
+     * convert byte positions to positions in the decoded text.
+     * UTF16 files are not affected by this. Like with SetMemoryMapping(),
+     * a const object can still be read from several threads at once.
+     * Default is false.
+     */
+    void                SetKeepBytes(bool keep) { keepBytes = keep; }
+
+    /**
+     * If set, the line information is stored in a compact form which
+     * needs about an eighth of the memory for files with short lines,
+     * at the cost of slightly slower lookups. See CLineIndex.
+     * ReplaceRange() converts the line information back to the normal form.
+     * Default is false.
+     */
+    void                SetCompactLineIndex(bool compact) { useCompactIndex = compact; }
+
+    /**
+     * Sets the code page used for files that are detected as ANSI.
+     * The code pages of CSingleByteCodePage are converted with built-in
+     * tables, all others with the OS converters.
+     * Default is CP_ACP.
+     */
+    void                SetAnsiCodePage(UINT cp) { ansiCodePage = cp; }
+
+    /**
+     * Tries to find out the encoding of a buffer (utf8, utf16, ansi).
+     * \param nullByteCount the number of null bytes that are allowed for
+     *                      the buffer to still be considered text
+     */
+    static UnicodeType DetectEncoding(const BYTE* pBuffer, int cb, int nullByteCount);
+
 protected:
     /**
      * Tries to find out the encoding of the file (utf8, utf16, ansi)
      */
-    UnicodeType CheckUnicodeType(BYTE* pBuffer, int cb) const;
+    UnicodeType CheckUnicodeType(const BYTE* pBuffer, int cb) const { return DetectEncoding(pBuffer, cb, nullByteCount); }
     /**
      * Fills an array with line information to make it faster later
      * to get the line from a char position.
@@ -145,12 +284,162 @@ protected:
     bool        CalculateLines(std::atomic_bool& bCancelled);
 
 private:
-    std::unique_ptr<BYTE[]> pFileBuf;
-    DWORD                   fileLen;
-    std::wstring            textContent;
+    bool         LoadMapped(HANDLE hFile, DWORD size, UnicodeType& type, bool bUTF8, std::atomic_bool& bCancelled);
+    const BYTE*  GetFileData() const;
+    size_t       GetLineCount() const;
+    /// returns the position of the line ending of the line with the zero based \c index
+    size_t       GetLineEnd(size_t index) const;
+    /// returns the index of the first line ending at or after \c pos, starting the search at \c index
+    size_t       FindLineEnd(size_t index, size_t pos) const;
+    /// encodes textContent into pFileBuf with the encoding of the file
+    void         EncodeContent() const;
+    /// makes sure pFileBuf can hold \c size bytes, reusing the current buffer if possible
+    bool         ReserveFileBuf(DWORD size);
+    /// decodes the raw file content between the code unit positions \c startPos and \c endPos
+    std::wstring DecodeRange(size_t startPos, size_t endPos) const;
+    /// builds positionMap over the raw UTF8 content if that wasn't done yet
+    bool         BuildPositionMap(const BYTE* pData, size_t len) const;
+
+    mutable std::unique_ptr<BYTE[]> pFileBuf;
+    mutable DWORD                   fileBufSize; ///< allocated size of pFileBuf
+    CMappedFile                     mappedFile;
+    mutable DWORD                   fileLen;
+    size_t                  dataOffset; ///< size of the BOM in the raw data
+    bool                    rawLines;   ///< line positions are raw code units, textContent is decoded on demand
+    bool                    useMapping;
+    bool                    keepBytes;  ///< don't convert UTF8/ANSI content to UTF16 on load
+    bool                    useCompactIndex;
+    UINT                    codePage;   ///< code page to decode UTF8/ANSI raw data with
+    UINT                    ansiCodePage;
+    mutable std::atomic_bool textDecoded;
+    mutable std::atomic_bool contentEncoded; ///< pFileBuf matches textContent, see ReplaceRange()
+    mutable std::mutex      lazyMutex;      ///< guards the decoding and encoding done by the const accessors
+    mutable std::wstring    textContent;
     std::vector<size_t>     linePositions;
+    CLineIndex              compactLines; ///< replaces linePositions if useCompactIndex is set
+    mutable CUTF8PositionMap positionMap; ///< built on first use for raw UTF8 content
+    mutable std::atomic_bool positionMapBuilt;
     UnicodeType             encoding;
     std::wstring            filename;
     bool                    hasBOM;
     int                     nullByteCount;
 };
+
+/**
+ * reads text files of any size through a window of fixed size.
+ * Every window holds complete lines, only lines longer than the window
+ * are split up. Partial characters and line endings at the end of the
+ * read data are carried over to the next window.
+ * Line numbers and byte offsets are 64-bit and refer to the whole file.
+ */
+class CTextFileReader
+{
+public:
+    CTextFileReader(size_t windowSize = 4 * 1024 * 1024);
+    ~CTextFileReader();
+
+    /**
+     * Opens the file at \c path and detects its encoding from the first window.
+     */
+    bool                Open(LPCWSTR path, CTextFile::UnicodeType& type, bool bUTF8);
+
+    /**
+     * Reads and decodes the next window of the file.
+     * \return false if the end of the file is reached or on errors
+     */
+    bool                ReadWindow(std::atomic_bool& bCancelled);
+
+    /**
+     * Returns the decoded text of the current window.
+     */
+    const std::wstring& GetWindowString() const { return windowText; }
+
+    /**
+     * Returns the line number of the first line in the current window.
+     */
+    UINT64              GetWindowLine() const { return windowLine; }
+
+    /**
+     * Returns the byte offset in the file of the start of the current window.
+     */
+    UINT64              GetWindowOffset() const { return windowOffset; }
+
+    /**
+     * Returns the line number in the file from a character position inside the current window.
+     */
+    UINT64              LineFromPosition(size_t pos) const;
+
+    /**
+     * Returns the byte offset in the file from a character position inside the current window.
+     */
+    UINT64              OffsetFromPosition(size_t pos) const;
+
+    /**
+     * Returns the line from a line number inside the current window.
+     * \return an empty string if the line is not part of the current window
+     */
+    std::wstring        GetLineString(UINT64 lineNumber) const;
+
+    /**
+     * Returns the size of the file in bytes
+     */
+    UINT64              GetFileLength() const { return fileLen; }
+
+    /**
+     * Returns the encoding of the file
+     */
+    CTextFile::UnicodeType GetEncoding() const { return encoding; }
+
+    bool                HasBOM() const { return hasBOM; }
+
+    /**
+     * Returns the file offset of the first invalid UTF8 sequence in the
+     * windows read so far, -1 if there is none.
+     * Only files read as UTF8 are validated.
+     */
+    INT64               GetUTF8ErrorOffset() const { return utf8Validator.GetErrorOffset(); }
+
+    /**
+     * Returns the number of invalid UTF8 sequences in the windows read so far.
+     */
+    size_t              GetUTF8ErrorCount() const { return utf8Validator.GetErrorCount(); }
+
+    /**
+     * Sets the number of null bytes that are allowed for
+     * a file to still be considered text instead of binary
+     * in the encoding detection. Default is 2.
+     */
+    void                SetNullbyteCountForBinary(int count) { nullByteCount = count; }
+
+    /**
+     * Sets the code page used for files that are detected as ANSI,
+     * see CTextFile::SetAnsiCodePage(). Call this before Open().
+     */
+    void                SetAnsiCodePage(UINT cp) { ansiCodePage = cp; }
+
+private:
+    bool   FillBuffer();
+    size_t FindWindowEnd() const;
+
+    CAutoFile               hFile;
+    std::unique_ptr<BYTE[]> rawBuf;
+    size_t                  windowSize;
+    size_t                  rawLen;      ///< bytes available in rawBuf
+    UINT64                  fileLen;
+    UINT64                  readOffset;  ///< file offset of the start of rawBuf
+    UINT64                  windowOffset;
+    UINT64                  windowLine;
+    UINT64                  nextLine;
+    bool                    eof;
+    bool                    hasBOM;
+    int                     nullByteCount;
+    UINT                    codePage;
+    UINT                    ansiCodePage;
+    CTextFile::UnicodeType  encoding;
+    std::wstring            windowText;
+    std::vector<size_t>     linePositions;
+    std::vector<size_t>     rawLinePositions;
+    std::string             windowRaw;       ///< raw bytes of the current window, UTF8 only
+    CUTF8PositionMap        windowPositions; ///< maps positions in windowText to windowRaw
+    CUTF8Validator          utf8Validator;
+};
@@ -0,0 +1,167 @@
+// sktoolslib - common files for SK tools
+
+// Copyright (C) 2026 - Stefan Kueng
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+#include "stdafx.h"
+#include "TextFileLoader.h"
+
+CTextFileLoader::CTextFileLoader(ThreadPool& pool, size_t prefetchCount, UINT64 byteBudget, bool inOrder)
+    : pool(pool)
+    , prefetchCount(max(prefetchCount, static_cast<size_t>(1)))
+    , byteBudget(byteBudget)
+    , inOrder(inOrder)
+    , bUTF8(false)
+    , nullByteCount(2)
+    , useMapping(false)
+    , keepBytes(false)
+    , compactLineIndex(false)
+    , ansiCodePage(CP_ACP)
+    , cancelled(false)
+    , finished(false)
+    , addedCount(0)
+    , handedOut(0)
+    , loading(0)
+    , bytesInUse(0)
+{
+}
+
+CTextFileLoader::~CTextFileLoader()
+{
+    Cancel();
+    // the tasks on the pool access this object: wait until they're done
+    std::unique_lock<std::mutex> lock(mutex);
+    cvReady.wait(lock, [this]() { return loading == 0; });
+}
+
+void CTextFileLoader::Add(const std::wstring& path, UINT64 size)
+{
+    if (size == static_cast<UINT64>(-1))
+    {
+        WIN32_FILE_ATTRIBUTE_DATA fileData{};
+        size = 0;
+        if (GetFileAttributesEx(path.c_str(), GetFileExInfoStandard, &fileData))
+            size = (static_cast<UINT64>(fileData.nFileSizeHigh) << 32) | fileData.nFileSizeLow;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    pending.push_back({addedCount++, path, size});
+    ScheduleLoads(lock);
+}
+
+void CTextFileLoader::Finish()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    finished = true;
+    cvReady.notify_all();
+}
+
+void CTextFileLoader::Cancel()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    cancelled = true;
+    pending.clear();
+    ready.clear();
+    completed.clear();
+    cvReady.notify_all();
+}
+
+bool CTextFileLoader::Next(LoadedFile& result)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;)
+    {
+        if (cancelled)
+            return false;
+        auto it = ready.end();
+        if (inOrder)
+            it = ready.find(handedOut);
+        else if (!completed.empty())
+        {
+            it = ready.find(completed.front());
+            completed.pop_front();
+        }
+        if (it != ready.end())
+        {
+            result = std::move(it->second.file);
+            bytesInUse -= it->second.size;
+            ready.erase(it);
+            ++handedOut;
+            ScheduleLoads(lock);
+            return true;
+        }
+        if (finished && (handedOut >= addedCount))
+            return false;
+        cvReady.wait(lock);
+    }
+}
+
+void CTextFileLoader::ScheduleLoads(std::unique_lock<std::mutex>& /*lock*/)
+{
+    while (!cancelled && !pending.empty() && (loading + ready.size() < prefetchCount))
+    {
+        auto& next = pending.front();
+        // a file that does not fit into the budget on its own is only loaded alone
+        if ((bytesInUse > 0) && (bytesInUse + next.size > byteBudget))
+            break;
+        PendingFile file = std::move(next);
+        pending.pop_front();
+        bytesInUse += file.size;
+        auto task = [this, file]() {
+            LoadedFile result;
+            result.path = file.path;
+            try
+            {
+                result.file = std::make_unique<CTextFile>();
+                result.file->SetNullbyteCountForBinary(nullByteCount);
+                result.file->SetMemoryMapping(useMapping);
+                result.file->SetKeepBytes(keepBytes);
+                result.file->SetCompactLineIndex(compactLineIndex);
+                result.file->SetAnsiCodePage(ansiCodePage);
+                result.loaded = result.file->Load(file.path.c_str(), result.type, bUTF8, cancelled);
+            }
+            catch (const std::exception&)
+            {
+                result.loaded = false;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            --loading;
+            if (cancelled)
+                bytesInUse -= file.size;
+            else
+            {
+                ready[file.index] = {std::move(result), file.size};
+                if (!inOrder)
+                    completed.push_back(file.index);
+            }
+            cvReady.notify_all();
+        };
+        try
+        {
+            pool.enqueue(std::move(task));
+        }
+        catch (const std::exception&)
+        {
+            // nothing is loading this file: put it back
+            bytesInUse -= file.size;
+            pending.push_front(std::move(file));
+            throw;
+        }
+        // the task can't finish before this: it needs the lock the caller holds
+        ++loading;
+    }
+}
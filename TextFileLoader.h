@@ -0,0 +1,125 @@
+// sktoolslib - common files for SK tools
+
+// Copyright (C) 2026 - Stefan Kueng
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+#pragma once
+
+#include "TextFile.h"
+#include "ThreadPool.h"
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+
+/**
+ * loads text files on a thread pool ahead of time.
+ * Paths are added with Add(), the loaded files are handed out with Next()
+ * while the following files are already being loaded in the background.
+ * The number of files loaded ahead and the number of bytes they may
+ * occupy are limited. A file bigger than the byte budget is only loaded
+ * when no other file is loaded or waiting to be handed out.
+ */
+class CTextFileLoader
+{
+public:
+    struct LoadedFile
+    {
+        std::wstring               path;
+        std::unique_ptr<CTextFile> file;
+        CTextFile::UnicodeType     type   = CTextFile::AutoType;
+        bool                       loaded = false; ///< the return value of CTextFile::Load()
+    };
+
+    /**
+     * \param pool the thread pool the files are loaded on. It must outlive the loader.
+     * \param prefetchCount the maximum number of files loaded ahead
+     * \param byteBudget the maximum number of bytes of the files loaded ahead
+     * \param inOrder if true, Next() returns the files in the order they were added,
+     *                otherwise in the order they finished loading
+     */
+    CTextFileLoader(ThreadPool& pool, size_t prefetchCount = 4, UINT64 byteBudget = 256 * 1024 * 1024, bool inOrder = true);
+    ~CTextFileLoader();
+
+    /// options passed to CTextFile::Load(). Must be set before the first Add().
+    void SetUTF8(bool utf8) { bUTF8 = utf8; }
+    void SetNullbyteCountForBinary(int count) { nullByteCount = count; }
+    void SetMemoryMapping(bool map) { useMapping = map; }
+    void SetKeepBytes(bool keep) { keepBytes = keep; }
+    void SetCompactLineIndex(bool compact) { compactLineIndex = compact; }
+    void SetAnsiCodePage(UINT cp) { ansiCodePage = cp; }
+
+    /**
+     * Adds a file to load. If the file size is not known, pass -1
+     * and it will be looked up.
+     */
+    void Add(const std::wstring& path, UINT64 size = static_cast<UINT64>(-1));
+
+    /**
+     * Tells the loader that no more files will be added.
+     */
+    void Finish();
+
+    /**
+     * Waits for the next loaded file.
+     * \return false if all files were handed out or the loader was cancelled
+     */
+    bool Next(LoadedFile& result);
+
+    /**
+     * Stops loading files. Files being loaded are cancelled and
+     * Next() returns false.
+     */
+    void Cancel();
+
+private:
+    struct PendingFile
+    {
+        size_t       index;
+        std::wstring path;
+        UINT64       size;
+    };
+    struct ReadyFile
+    {
+        LoadedFile file;
+        UINT64     size;
+    };
+    void ScheduleLoads(std::unique_lock<std::mutex>& lock);
+
+    ThreadPool&                    pool;
+    size_t                         prefetchCount;
+    UINT64                         byteBudget;
+    bool                           inOrder;
+    bool                           bUTF8;
+    int                            nullByteCount;
+    bool                           useMapping;
+    bool                           keepBytes;
+    bool                           compactLineIndex;
+    UINT                           ansiCodePage;
+
+    std::mutex                     mutex;
+    std::condition_variable        cvReady;
+    std::atomic_bool               cancelled;
+    bool                           finished;
+    size_t                         addedCount;
+    size_t                         handedOut;  ///< also the index of the next file to hand out if inOrder is set
+    size_t                         loading;    ///< number of files currently loaded on the pool
+    UINT64                         bytesInUse; ///< bytes of the files loading or waiting to be handed out
+    std::deque<PendingFile>        pending;
+    std::map<size_t, ReadyFile>    ready;
+    std::deque<size_t>             completed;  ///< indexes of the ready files in the order they finished
+};
@@ -0,0 +1,201 @@
+// sktoolslib - common files for SK tools
+
+// Copyright (C) 2026 - Stefan Kueng
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+#include "stdafx.h"
+#include "UTF8PositionMap.h"
+#include "UnicodeUtils.h"
+#include "UTF8Validator.h"
+#include "UTFTranscoder.h"
+#include <algorithm>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#    include <emmintrin.h>
+#endif
+
+static BOOL sse2Supported = ::IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE);
+
+static int PopCount16(unsigned int mask)
+{
+    mask = mask - ((mask >> 1) & 0x5555);
+    mask = (mask & 0x3333) + ((mask >> 2) & 0x3333);
+    mask = (mask + (mask >> 4)) & 0x0F0F;
+    return static_cast<int>((mask + (mask >> 8)) & 0x1F);
+}
+
+CUTF8PositionMap::CUTF8PositionMap()
+    : text(nullptr)
+    , len(0)
+{
+}
+
+bool CUTF8PositionMap::Build(const char* pText, size_t length)
+{
+    Clear();
+    text = reinterpret_cast<const unsigned char*>(pText);
+    len  = length;
+    try
+    {
+        counts.reserve(length / blockSize + 1);
+        CUTF8Validator validator;
+        validator.Feed(pText, length);
+        if (!validator.Finish())
+        {
+            // counting lead bytes is only exact for valid UTF8
+            BuildDecoded();
+            return true;
+        }
+        size_t units = 0;
+        counts.push_back(0);
+        for (size_t pos = 0; pos + blockSize <= length; pos += blockSize)
+        {
+            units += CountUnits(text + pos, blockSize);
+            counts.push_back(units);
+        }
+    }
+    catch (const std::exception&)
+    {
+        Clear();
+        return false;
+    }
+    return true;
+}
+
+void CUTF8PositionMap::BuildDecoded()
+{
+    starts.reserve(len / blockSize + 1);
+    size_t i         = 0;
+    size_t units     = 0;
+    size_t nextBlock = 0;
+    while (i < len)
+    {
+        // the first char that starts at or after a block start
+        for (; nextBlock <= i; nextBlock += blockSize)
+        {
+            starts.push_back(i);
+            counts.push_back(units);
+        }
+        units += (UTFTranscoder::DecodeUTF8(text, len, i) >= 0x10000) ? 2 : 1;
+    }
+    for (; nextBlock <= len; nextBlock += blockSize)
+    {
+        starts.push_back(len);
+        counts.push_back(units);
+    }
+}
+
+void CUTF8PositionMap::Clear()
+{
+    counts.clear();
+    starts.clear();
+    text = nullptr;
+    len  = 0;
+}
+
+size_t CUTF8PositionMap::UTF16Length() const
+{
+    return UTF16FromUTF8(len);
+}
+
+size_t CUTF8PositionMap::UTF16FromUTF8(size_t pos) const
+{
+    if (counts.empty())
+        return 0;
+    pos = min(pos, len);
+    if (!starts.empty())
+        return DecodedUTF16FromUTF8(pos);
+    size_t block = pos / blockSize;
+    return counts[block] + CountUnits(text + block * blockSize, pos - block * blockSize);
+}
+
+size_t CUTF8PositionMap::DecodedUTF16FromUTF8(size_t pos) const
+{
+    size_t block = pos / blockSize;
+    // pos might be inside a char that started in the previous block
+    if ((block > 0) && (starts[block] > pos))
+        --block;
+    size_t i     = starts[block];
+    size_t units = counts[block];
+    while (i < pos)
+        units += (UTFTranscoder::DecodeUTF8(text, len, i) >= 0x10000) ? 2 : 1;
+    return units;
+}
+
+size_t CUTF8PositionMap::UTF8FromUTF16(size_t pos) const
+{
+    if (counts.empty() || (pos == 0))
+        return 0;
+    if (!starts.empty())
+        return DecodedUTF8FromUTF16(pos);
+    // start at the last block that begins before the position
+    auto   it    = std::lower_bound(counts.cbegin(), counts.cend(), pos);
+    size_t block = std::distance(counts.cbegin(), it) - 1;
+    size_t i     = block * blockSize;
+    size_t units = counts[block];
+    // a block might start in the middle of a character that was already counted
+    while ((block > 0) && (i < len) && UTF8Helper::isContinuation(text[i]))
+        ++i;
+    while ((i < len) && (units < pos))
+    {
+        units += (text[i] >= 0xF0) ? 2 : 1;
+        ++i;
+        while ((i < len) && UTF8Helper::isContinuation(text[i]))
+            ++i;
+    }
+    return i;
+}
+
+size_t CUTF8PositionMap::DecodedUTF8FromUTF16(size_t pos) const
+{
+    // start at the last checkpoint before the position
+    auto   it    = std::lower_bound(counts.cbegin(), counts.cend(), pos);
+    size_t block = std::distance(counts.cbegin(), it) - 1;
+    size_t i     = starts[block];
+    size_t units = counts[block];
+    while ((i < len) && (units < pos))
+        units += (UTFTranscoder::DecodeUTF8(text, len, i) >= 0x10000) ? 2 : 1;
+    return i;
+}
+
+size_t CUTF8PositionMap::CountUnits(const unsigned char* pData, size_t length)
+{
+    size_t units = 0;
+    size_t i     = 0;
+#if defined(_M_IX86) || defined(_M_X64)
+    if (sse2Supported)
+    {
+        // continuation bytes are 0x80-0xBF, i.e. smaller than -64 as signed chars.
+        // Bytes from 0xF0 up start a four byte sequence which needs two code units.
+        const __m128i contLimit = _mm_set1_epi8(-64);
+        const __m128i fourByte  = _mm_set1_epi8(static_cast<char>(0xF0));
+        for (; i + 16 <= length; i += 16)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pData + i));
+            int     cont  = _mm_movemask_epi8(_mm_cmplt_epi8(chunk, contLimit));
+            int     four  = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(chunk, fourByte), chunk));
+            units += 16 - PopCount16(cont) + PopCount16(four);
+        }
+    }
+#endif
+    for (; i < length; ++i)
+    {
+        if (!UTF8Helper::isContinuation(pData[i]))
+            units += (pData[i] >= 0xF0) ? 2 : 1;
+    }
+    return units;
+}
@@ -0,0 +1,72 @@
+// sktoolslib - common files for SK tools
+
+// Copyright (C) 2026 - Stefan Kueng
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+#pragma once
+
+#include <vector>
+
+/**
+ * translates positions between a UTF8 buffer and its UTF16 representation.
+ * Build() stores the number of UTF16 code units before every 256th byte,
+ * so a translation only has to scan at most one block instead of the
+ * whole buffer from the start.
+ * The map only keeps a pointer to the buffer: the buffer must stay valid
+ * and unchanged until the map is cleared or built again.
+ * The counts are the same as MultiByteToWideChar produces. Valid UTF8 is
+ * counted with SSE2: every byte that is not a continuation byte counts as
+ * one UTF16 code unit, lead bytes of four byte sequences count as two.
+ * If the buffer contains invalid sequences, it is decoded like
+ * UTFTranscoder does, counting one U+FFFD per maximal subpart, and the
+ * start of the first char in every block is stored as well.
+ */
+class CUTF8PositionMap
+{
+public:
+    CUTF8PositionMap();
+
+    bool   Build(const char* text, size_t len);
+    void   Clear();
+
+    bool   empty() const { return counts.empty(); }
+
+    /// returns the number of UTF16 code units of the whole buffer
+    size_t UTF16Length() const;
+
+    /// returns the number of UTF16 code units before the byte position \c pos
+    size_t UTF16FromUTF8(size_t pos) const;
+
+    /// returns the byte position of the character that ends at the UTF16
+    /// position \c pos. A position inside a surrogate pair returns the
+    /// position after the four byte sequence.
+    size_t UTF8FromUTF16(size_t pos) const;
+
+private:
+    static constexpr size_t blockSize = 256;
+
+    static size_t CountUnits(const unsigned char* text, size_t len);
+
+    void          BuildDecoded();
+    size_t        DecodedUTF16FromUTF8(size_t pos) const;
+    size_t        DecodedUTF8FromUTF16(size_t pos) const;
+
+    const unsigned char* text;
+    size_t               len;
+    std::vector<size_t>  counts;
+    std::vector<size_t>  starts; ///< for invalid UTF8: the first char that starts in each block
+};
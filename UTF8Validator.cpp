@@ -0,0 +1,166 @@
+// sktoolslib - common files for SK tools
+
+// Copyright (C) 2026 - Stefan Kueng
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+#include "stdafx.h"
+#include "UTF8Validator.h"
+
+#if defined(_M_IX86) || defined(_M_X64)
+#    include <emmintrin.h>
+#endif
+
+static BOOL sse2Supported = ::IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE);
+
+namespace
+{
+// byte classes:
+// 0: 00-7F, 1: 80-8F, 2: 90-9F, 3: A0-BF, 4: C2-DF, 5: E0, 6: E1-EC and EE-EF,
+// 7: ED, 8: F0, 9: F1-F3, 10: F4, 11: C0, C1 and F5-FF
+constexpr BYTE ByteClass(int c)
+{
+    if (c < 0x80)
+        return 0;
+    if (c < 0x90)
+        return 1;
+    if (c < 0xA0)
+        return 2;
+    if (c < 0xC0)
+        return 3;
+    if (c < 0xC2)
+        return 11;
+    if (c < 0xE0)
+        return 4;
+    if (c == 0xE0)
+        return 5;
+    if (c == 0xED)
+        return 7;
+    if (c < 0xF0)
+        return 6;
+    if (c == 0xF0)
+        return 8;
+    if (c < 0xF4)
+        return 9;
+    if (c == 0xF4)
+        return 10;
+    return 11;
+}
+
+struct ByteClassTable
+{
+    BYTE table[256];
+    constexpr ByteClassTable()
+        : table()
+    {
+        for (int i = 0; i < 256; ++i)
+            table[i] = ByteClass(i);
+    }
+};
+
+constexpr ByteClassTable byteClasses;
+
+// states: 0 accept, 1-3 that many continuation bytes left,
+// 4 after E0, 5 after ED, 6 after F0, 7 after F4, 8 reject
+constexpr BYTE Reject = 8;
+
+// clang-format off
+constexpr BYTE transitions[8][12] = {
+    // 0  1  2  3  4  5  6  7  8  9  10 11
+    {  0, 8, 8, 8, 1, 4, 2, 5, 6, 3, 7, 8 }, // accept
+    {  8, 0, 0, 0, 8, 8, 8, 8, 8, 8, 8, 8 }, // one continuation byte left
+    {  8, 1, 1, 1, 8, 8, 8, 8, 8, 8, 8, 8 }, // two continuation bytes left
+    {  8, 2, 2, 2, 8, 8, 8, 8, 8, 8, 8, 8 }, // three continuation bytes left
+    {  8, 8, 8, 1, 8, 8, 8, 8, 8, 8, 8, 8 }, // E0: A0-BF, no overlong encodings
+    {  8, 1, 1, 8, 8, 8, 8, 8, 8, 8, 8, 8 }, // ED: 80-9F, no surrogates
+    {  8, 8, 2, 2, 8, 8, 8, 8, 8, 8, 8, 8 }, // F0: 90-BF, no overlong encodings
+    {  8, 2, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8 }, // F4: 80-8F, nothing above U+10FFFF
+};
+// clang-format on
+} // namespace
+
+CUTF8Validator::CUTF8Validator(UINT64 startOffset)
+{
+    Reset(startOffset);
+}
+
+void CUTF8Validator::Reset(UINT64 startOffset)
+{
+    state          = 0;
+    offset         = startOffset;
+    sequenceOffset = startOffset;
+    errorOffset    = -1;
+    errorCount     = 0;
+}
+
+bool CUTF8Validator::Feed(const void* pData, size_t len)
+{
+    const auto* pBytes = static_cast<const BYTE*>(pData);
+    size_t      i      = 0;
+    while (i < len)
+    {
+        if (state == 0)
+        {
+            // skip ascii chars
+#if defined(_M_IX86) || defined(_M_X64)
+            if (sse2Supported)
+            {
+                while ((i + 16 <= len) && (_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pBytes + i))) == 0))
+                    i += 16;
+            }
+#endif
+            while ((i < len) && (pBytes[i] < 0x80))
+                ++i;
+            if (i >= len)
+                break;
+            sequenceOffset = offset + i;
+        }
+        BYTE next = transitions[state][byteClasses.table[pBytes[i]]];
+        if (next == Reject)
+        {
+            AddError();
+            // the byte that ends an incomplete sequence can start the next one
+            if (state != 0)
+            {
+                state = 0;
+                continue;
+            }
+            ++i;
+            continue;
+        }
+        state = next;
+        ++i;
+    }
+    offset += len;
+    return errorCount == 0;
+}
+
+bool CUTF8Validator::Finish()
+{
+    if (state != 0)
+    {
+        AddError();
+        state = 0;
+    }
+    return errorCount == 0;
+}
+
+void CUTF8Validator::AddError()
+{
+    if (errorCount == 0)
+        errorOffset = static_cast<INT64>(sequenceOffset);
+    ++errorCount;
+}
@@ -0,0 +1,71 @@
+// sktoolslib - common files for SK tools
+
+// Copyright (C) 2026 - Stefan Kueng
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+#pragma once
+
+/**
+ * validates UTF8 data that arrives in chunks of any size, e.g. while
+ * reading a file or downloading it. A sequence split between two chunks
+ * is continued with the next chunk, so the data doesn't have to be
+ * buffered.
+ * The validation is a DFA over byte classes that rejects overlong
+ * encodings, surrogates and code points above U+10FFFF. Runs of ASCII
+ * chars are skipped 16 bytes at a time with SSE2.
+ * Invalid sequences are counted like MultiByteToWideChar replaces them:
+ * one per maximal subpart.
+ */
+class CUTF8Validator
+{
+public:
+    /// \param startOffset the offset of the first byte, added to the reported error offset
+    CUTF8Validator(UINT64 startOffset = 0);
+
+    void   Reset(UINT64 startOffset = 0);
+
+    /// validates the next chunk of data.
+    /// \return false if the data so far contains an invalid sequence
+    bool   Feed(const void* pData, size_t len);
+
+    /// ends the data: a sequence that is still incomplete counts as invalid.
+    /// \return false if the data contains an invalid sequence
+    bool   Finish();
+
+    bool   IsValid() const { return errorCount == 0; }
+
+    /// returns true if the data fed so far doesn't end inside a sequence
+    bool   IsComplete() const { return state == 0; }
+
+    /// returns the offset of the first invalid sequence, -1 if there is none
+    INT64  GetErrorOffset() const { return errorOffset; }
+
+    /// returns the number of invalid sequences
+    size_t GetErrorCount() const { return errorCount; }
+
+    /// returns the offset after the last byte that was fed
+    UINT64 GetOffset() const { return offset; }
+
+private:
+    void   AddError();
+
+    BYTE   state;
+    UINT64 offset;         ///< offset of the next byte
+    UINT64 sequenceOffset; ///< offset of the lead byte of the current sequence
+    INT64  errorOffset;
+    size_t errorCount;
+};
@@ -0,0 +1,341 @@
+// sktoolslib - common files for SK tools
+
+// Copyright (C) 2026 - Stefan Kueng
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#    include <emmintrin.h>
+#    define UTFTRANSCODER_SSE2
+#endif
+
+// converts between UTF-8 and UTF-16 without using the Windows API, so it
+// also works on other platforms. CharT is the 16-bit code unit type:
+// wchar_t on Windows, char16_t elsewhere.
+//
+// The output length is calculated exactly before converting, so the result
+// can be written directly into the destination string.
+// Invalid UTF-8 sequences and unpaired surrogates are replaced with U+FFFD,
+// an invalid UTF-8 sequence is replaced by one U+FFFD per maximal subpart
+// just like MultiByteToWideChar does.
+// Runs of ASCII characters are converted 16 bytes at a time with SSE2.
+class UTFTranscoder
+{
+public:
+    // returns the number of UTF-16 code units needed for the UTF-8 string
+    static size_t UTF16Length(const char* src, size_t len)
+    {
+        const auto* s     = reinterpret_cast<const unsigned char*>(src);
+        size_t      i     = 0;
+        size_t      count = 0;
+        while (i < len)
+        {
+            size_t ascii = AsciiRun(s + i, len - i);
+            i += ascii;
+            count += ascii;
+            if (i >= len)
+                break;
+            count += (DecodeUTF8(s, len, i) >= 0x10000) ? 2 : 1;
+        }
+        return count;
+    }
+
+    // converts the UTF-8 string to UTF-16. \c dst must have room for
+    // UTF16Length() code units. Returns the number of code units written.
+    template <typename CharT>
+    static size_t UTF8ToUTF16(const char* src, size_t len, CharT* dst)
+    {
+        static_assert(sizeof(CharT) == 2, "UTF-16 needs a 16-bit code unit type");
+        const auto* s = reinterpret_cast<const unsigned char*>(src);
+        CharT*      d = dst;
+        size_t      i = 0;
+        while (i < len)
+        {
+#ifdef UTFTRANSCODER_SSE2
+            const __m128i zero = _mm_setzero_si128();
+            while (i + 16 <= len)
+            {
+                __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+                if (_mm_movemask_epi8(chunk) != 0)
+                    break;
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm_unpacklo_epi8(chunk, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 8), _mm_unpackhi_epi8(chunk, zero));
+                i += 16;
+                d += 16;
+            }
+#endif
+            while ((i < len) && (s[i] < 0x80))
+                *d++ = static_cast<CharT>(s[i++]);
+            if (i >= len)
+                break;
+            char32_t cp = DecodeUTF8(s, len, i);
+            if (cp >= 0x10000)
+            {
+                cp -= 0x10000;
+                *d++ = static_cast<CharT>(0xD800 + (cp >> 10));
+                *d++ = static_cast<CharT>(0xDC00 + (cp & 0x3FF));
+            }
+            else
+                *d++ = static_cast<CharT>(cp);
+        }
+        return d - dst;
+    }
+
+    // returns the number of UTF-8 bytes needed for the UTF-16 string
+    template <typename CharT>
+    static size_t UTF8Length(const CharT* src, size_t len)
+    {
+        size_t i     = 0;
+        size_t count = 0;
+        while (i < len)
+        {
+            size_t ascii = AsciiRun(src + i, len - i);
+            i += ascii;
+            count += ascii;
+            if (i >= len)
+                break;
+            count += EncodedLength(src, len, i);
+        }
+        return count;
+    }
+
+    // converts the UTF-16 string to UTF-8. \c dst must have room for
+    // UTF8Length() bytes. Returns the number of bytes written.
+    template <typename CharT>
+    static size_t UTF16ToUTF8(const CharT* src, size_t len, char* dst)
+    {
+        static_assert(sizeof(CharT) == 2, "UTF-16 needs a 16-bit code unit type");
+        auto*  d = reinterpret_cast<unsigned char*>(dst);
+        size_t i = 0;
+        while (i < len)
+        {
+#ifdef UTFTRANSCODER_SSE2
+            const __m128i nonAscii = _mm_set1_epi16(static_cast<short>(0xFF80));
+            const __m128i zero     = _mm_setzero_si128();
+            while (i + 8 <= len)
+            {
+                __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(chunk, nonAscii), zero)) != 0xFFFF)
+                    break;
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(d), _mm_packus_epi16(chunk, chunk));
+                i += 8;
+                d += 8;
+            }
+#endif
+            while ((i < len) && (static_cast<uint16_t>(src[i]) < 0x80))
+                *d++ = static_cast<unsigned char>(src[i++]);
+            if (i >= len)
+                break;
+            char32_t cp = DecodeUTF16(src, len, i);
+            if (cp < 0x800)
+            {
+                *d++ = static_cast<unsigned char>(0xC0 | (cp >> 6));
+                *d++ = static_cast<unsigned char>(0x80 | (cp & 0x3F));
+            }
+            else if (cp < 0x10000)
+            {
+                *d++ = static_cast<unsigned char>(0xE0 | (cp >> 12));
+                *d++ = static_cast<unsigned char>(0x80 | ((cp >> 6) & 0x3F));
+                *d++ = static_cast<unsigned char>(0x80 | (cp & 0x3F));
+            }
+            else
+            {
+                *d++ = static_cast<unsigned char>(0xF0 | (cp >> 18));
+                *d++ = static_cast<unsigned char>(0x80 | ((cp >> 12) & 0x3F));
+                *d++ = static_cast<unsigned char>(0x80 | ((cp >> 6) & 0x3F));
+                *d++ = static_cast<unsigned char>(0x80 | (cp & 0x3F));
+            }
+        }
+        return d - reinterpret_cast<unsigned char*>(dst);
+    }
+
+    // converts the UTF-8 string into \c dst, replacing its content
+    template <typename StringT>
+    static void UTF8ToUTF16(const char* src, size_t len, StringT& dst)
+    {
+        dst.clear();
+        AppendUTF8ToUTF16(src, len, dst);
+    }
+
+    // converts the UTF-16 string into \c dst, replacing its content
+    template <typename CharT>
+    static void UTF16ToUTF8(const CharT* src, size_t len, std::string& dst)
+    {
+        dst.clear();
+        AppendUTF16ToUTF8(src, len, dst);
+    }
+
+    // appends the converted UTF-8 string to \c dst. The string only
+    // allocates if its capacity is too small. Returns the number of code units appended.
+    template <typename StringT>
+    static size_t AppendUTF8ToUTF16(const char* src, size_t len, StringT& dst)
+    {
+        size_t oldSize = dst.size();
+        size_t count   = UTF16Length(src, len);
+        dst.resize(oldSize + count);
+        UTF8ToUTF16(src, len, dst.data() + oldSize);
+        return count;
+    }
+
+    // appends the converted UTF-16 string to \c dst. The string only
+    // allocates if its capacity is too small. Returns the number of bytes appended.
+    template <typename CharT>
+    static size_t AppendUTF16ToUTF8(const CharT* src, size_t len, std::string& dst)
+    {
+        size_t oldSize = dst.size();
+        size_t count   = UTF8Length(src, len);
+        dst.resize(oldSize + count);
+        UTF16ToUTF8(src, len, dst.data() + oldSize);
+        return count;
+    }
+
+    // decodes the sequence at \c i and moves \c i past it.
+    // Invalid sequences return U+FFFD and only skip the maximal subpart.
+    static char32_t DecodeUTF8(const unsigned char* s, size_t len, size_t& i)
+    {
+        unsigned char lead  = s[i++];
+        unsigned char lower = 0x80;
+        unsigned char upper = 0xBF;
+        int           need  = 0;
+        char32_t      cp    = 0;
+        if (lead < 0x80)
+            return lead;
+        if ((lead >= 0xC2) && (lead <= 0xDF))
+        {
+            need = 1;
+            cp   = lead & 0x1F;
+        }
+        else if ((lead >= 0xE0) && (lead <= 0xEF))
+        {
+            need = 2;
+            cp   = lead & 0x0F;
+            if (lead == 0xE0)
+                lower = 0xA0; // overlong
+            else if (lead == 0xED)
+                upper = 0x9F; // surrogates
+        }
+        else if ((lead >= 0xF0) && (lead <= 0xF4))
+        {
+            need = 3;
+            cp   = lead & 0x07;
+            if (lead == 0xF0)
+                lower = 0x90; // overlong
+            else if (lead == 0xF4)
+                upper = 0x8F; // above U+10FFFF
+        }
+        else
+            return 0xFFFD;
+
+        for (; need > 0; --need)
+        {
+            if ((i >= len) || (s[i] < lower) || (s[i] > upper))
+                return 0xFFFD;
+            cp    = (cp << 6) | (s[i++] & 0x3F);
+            lower = 0x80;
+            upper = 0xBF;
+        }
+        return cp;
+    }
+
+private:
+    // returns the number of ASCII chars at the start of the buffer
+    static size_t AsciiRun(const unsigned char* s, size_t len)
+    {
+        size_t i = 0;
+#ifdef UTFTRANSCODER_SSE2
+        for (; i + 16 <= len; i += 16)
+        {
+            int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i)));
+            if (mask != 0)
+                return i + TrailingZeros(mask);
+        }
+#endif
+        while ((i < len) && (s[i] < 0x80))
+            ++i;
+        return i;
+    }
+
+    template <typename CharT>
+    static size_t AsciiRun(const CharT* s, size_t len)
+    {
+        size_t i = 0;
+#ifdef UTFTRANSCODER_SSE2
+        const __m128i nonAscii = _mm_set1_epi16(static_cast<short>(0xFF80));
+        const __m128i zero     = _mm_setzero_si128();
+        for (; i + 8 <= len; i += 8)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+            int     mask  = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(chunk, nonAscii), zero)) ^ 0xFFFF;
+            if (mask != 0)
+                return i + TrailingZeros(mask) / 2;
+        }
+#endif
+        while ((i < len) && (static_cast<uint16_t>(s[i]) < 0x80))
+            ++i;
+        return i;
+    }
+
+    static unsigned int TrailingZeros(int mask)
+    {
+        unsigned int n = 0;
+        while ((mask & 1) == 0)
+        {
+            mask >>= 1;
+            ++n;
+        }
+        return n;
+    }
+
+    // decodes the code point at \c i and moves \c i past it.
+    // Unpaired surrogates return U+FFFD.
+    template <typename CharT>
+    static char32_t DecodeUTF16(const CharT* s, size_t len, size_t& i)
+    {
+        char32_t c = static_cast<uint16_t>(s[i++]);
+        if ((c < 0xD800) || (c > 0xDFFF))
+            return c;
+        if ((c <= 0xDBFF) && (i < len))
+        {
+            char32_t c2 = static_cast<uint16_t>(s[i]);
+            if ((c2 >= 0xDC00) && (c2 <= 0xDFFF))
+            {
+                ++i;
+                return 0x10000 + ((c - 0xD800) << 10) + (c2 - 0xDC00);
+            }
+        }
+        return 0xFFFD;
+    }
+
+    template <typename CharT>
+    static size_t EncodedLength(const CharT* s, size_t len, size_t& i)
+    {
+        char32_t cp = DecodeUTF16(s, len, i);
+        if (cp < 0x80)
+            return 1;
+        if (cp < 0x800)
+            return 2;
+        if (cp < 0x10000)
+            return 3;
+        return 4;
+    }
+};
@@ -1,6 +1,6 @@
 ﻿// sktoolslib - common files for SK tools
 
-// Copyright (C) 2012-2013, 2017, 2020-2021, 2024 - Stefan Kueng
+// Copyright (C) 2012-2013, 2017, 2020-2021, 2024, 2026 - Stefan Kueng
 
 // This program is free software; you can redistribute it and/or
 // modify it under the terms of the GNU General Public License
@@ -19,7 +19,40 @@
 
 #include "stdafx.h"
 #include "UnicodeUtils.h"
+#include "UTFTranscoder.h"
+#include "SingleByteCodePage.h"
 #include <memory>
+#include <bitset>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#    include <emmintrin.h>
+#endif
+
+static BOOL sse2Supported = ::IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE);
+
+// returns the length of the string up to the first null char if \c stopAtNull is set
+template <typename CharT>
+static size_t ConvertLength(const CharT* str, size_t len, bool stopAtNull)
+{
+    if (!stopAtNull)
+        return len;
+    const CharT* pNull = std::char_traits<CharT>::find(str, len, CharT());
+    return pNull ? pNull - str : len;
+}
+
+static std::string UTF16ToUTF8(const wchar_t* wide, size_t len, bool stopAtNull)
+{
+    std::string narrow;
+    UTFTranscoder::UTF16ToUTF8(wide, ConvertLength(wide, len, stopAtNull), narrow);
+    return narrow;
+}
+
+static std::wstring UTF8ToUTF16(const char* multibyte, size_t len, bool stopAtNull)
+{
+    std::wstring wide;
+    UTFTranscoder::UTF8ToUTF16(multibyte, ConvertLength(multibyte, len, stopAtNull), wide);
+    return wide;
+}
 
 CUnicodeUtils::CUnicodeUtils()
 {
@@ -32,16 +65,7 @@ CUnicodeUtils::~CUnicodeUtils()
 #ifdef UNICODE
 std::string CUnicodeUtils::StdGetUTF8(const std::wstring& wide, bool stopAtNull /* = true*/)
 {
-    int len = static_cast<int>(wide.size());
-    if (len == 0)
-        return std::string();
-    int  size   = len * 4;
-    auto narrow = std::make_unique<char[]>(size);
-    int  ret    = WideCharToMultiByte(CP_UTF8, 0, wide.c_str(), len, narrow.get(), size - 1, nullptr, nullptr);
-    narrow[ret] = 0;
-    if (stopAtNull)
-        return std::string(narrow.get());
-    return std::string(narrow.get(), ret);
+    return UTF16ToUTF8(wide.c_str(), wide.size(), stopAtNull);
 }
 
 std::string CUnicodeUtils::StdGetANSI(const std::wstring& wide, bool stopAtNull /* = true*/)
@@ -60,16 +84,7 @@ std::string CUnicodeUtils::StdGetANSI(const std::wstring& wide, bool stopAtNull
 
 std::wstring CUnicodeUtils::StdGetUnicode(const std::string& multibyte, bool stopAtNull)
 {
-    int len = static_cast<int>(multibyte.size());
-    if (len == 0)
-        return std::wstring();
-    int  size = len * 4;
-    auto wide = std::make_unique<wchar_t[]>(size);
-    int  ret  = MultiByteToWideChar(CP_UTF8, 0, multibyte.c_str(), len, wide.get(), size - 1);
-    wide[ret] = 0;
-    if (stopAtNull)
-        return std::wstring(wide.get());
-    return std::wstring(wide.get(), ret);
+    return UTF8ToUTF16(multibyte.c_str(), multibyte.size(), stopAtNull);
 }
 #endif
 
@@ -97,22 +112,12 @@ std::string WideToMultibyte(const std::wstring_view& wide, bool stopAtNull /* =
 
 std::string WideToUTF8(const std::wstring& wide, bool stopAtNull /* = true*/)
 {
-    auto narrow = std::make_unique<char[]>(wide.length() * 3 + 2);
-    int  ret    = static_cast<int>(WideCharToMultiByte(CP_UTF8, 0, wide.c_str(), static_cast<int>(wide.size()), narrow.get(), static_cast<int>(wide.length()) * 3 - 1, nullptr, nullptr));
-    narrow[ret] = 0;
-    if (stopAtNull)
-        return narrow.get();
-    return std::string(narrow.get(), ret);
+    return UTF16ToUTF8(wide.c_str(), wide.size(), stopAtNull);
 }
 
 std::string WideToUTF8(const std::wstring_view& wide, bool stopAtNull /* = true*/)
 {
-    auto narrow = std::make_unique<char[]>(wide.length() * 3 + 2);
-    int  ret    = static_cast<int>(WideCharToMultiByte(CP_UTF8, 0, wide.data(), static_cast<int>(wide.size()), narrow.get(), static_cast<int>(wide.length()) * 3 - 1, nullptr, nullptr));
-    narrow[ret] = 0;
-    if (stopAtNull)
-        return narrow.get();
-    return std::string(narrow.get(), ret);
+    return UTF16ToUTF8(wide.data(), wide.size(), stopAtNull);
 }
 
 std::wstring MultibyteToWide(const std::string& multibyte, bool stopAtNull /* = true*/)
@@ -149,34 +154,90 @@ std::wstring MultibyteToWide(const std::string_view& multibyte, bool stopAtNull
 
 std::wstring UTF8ToWide(const std::string& multibyte, bool stopAtNull /* = true*/)
 {
-    size_t length = multibyte.length();
-    if (length == 0)
-        return std::wstring();
-
-    auto wide = std::make_unique<wchar_t[]>(length * 2 + 2);
-    if (wide == nullptr)
-        return std::wstring();
-    int ret   = static_cast<int>(MultiByteToWideChar(CP_UTF8, 0, multibyte.c_str(), static_cast<int>(multibyte.size()), wide.get(), static_cast<int>(length) * 2 - 1));
-    wide[ret] = 0;
-    if (stopAtNull)
-        return wide.get();
-    return std::wstring(wide.get(), ret);
+    return UTF8ToUTF16(multibyte.c_str(), multibyte.size(), stopAtNull);
 }
 
 std::wstring UTF8ToWide(const std::string_view& multibyte, bool stopAtNull /* = true*/)
 {
-    size_t length = multibyte.length();
-    if (length == 0)
-        return std::wstring();
+    return UTF8ToUTF16(multibyte.data(), multibyte.size(), stopAtNull);
+}
 
-    auto wide = std::make_unique<wchar_t[]>(length * 2 + 2);
-    if (wide == nullptr)
+size_t WideToUTF8(std::wstring_view wide, std::string& dst)
+{
+    return UTFTranscoder::AppendUTF16ToUTF8(wide.data(), wide.size(), dst);
+}
+
+size_t UTF8ToWide(std::string_view multibyte, std::wstring& dst)
+{
+    return UTFTranscoder::AppendUTF8ToUTF16(multibyte.data(), multibyte.size(), dst);
+}
+
+size_t WideToUTF8(std::wstring_view wide, char* dst, size_t dstSize)
+{
+    size_t len = UTFTranscoder::UTF8Length(wide.data(), wide.size());
+    if (len <= dstSize)
+        UTFTranscoder::UTF16ToUTF8(wide.data(), wide.size(), dst);
+    return len;
+}
+
+size_t UTF8ToWide(std::string_view multibyte, wchar_t* dst, size_t dstSize)
+{
+    size_t len = UTFTranscoder::UTF16Length(multibyte.data(), multibyte.size());
+    if (len <= dstSize)
+        UTFTranscoder::UTF8ToUTF16(multibyte.data(), multibyte.size(), dst);
+    return len;
+}
+
+std::string_view WideToUTF8Scratch(std::wstring_view wide)
+{
+    thread_local std::string scratch;
+    scratch.clear();
+    WideToUTF8(wide, scratch);
+    return scratch;
+}
+
+std::wstring_view UTF8ToWideScratch(std::string_view multibyte)
+{
+    thread_local std::wstring scratch;
+    scratch.clear();
+    UTF8ToWide(multibyte, scratch);
+    return scratch;
+}
+
+std::wstring CodePageToWide(std::string_view text, UINT codePage)
+{
+    if (text.empty())
         return std::wstring();
-    int ret   = static_cast<int>(MultiByteToWideChar(CP_UTF8, 0, multibyte.data(), static_cast<int>(multibyte.size()), wide.get(), static_cast<int>(length) * 2 - 1));
-    wide[ret] = 0;
-    if (stopAtNull)
-        return wide.get();
-    return std::wstring(wide.get(), ret);
+    std::wstring wide;
+    if (const auto* pSingleByte = CSingleByteCodePage::Get(codePage))
+    {
+        wide.resize(text.size());
+        pSingleByte->ToWide(text.data(), text.size(), wide.data());
+        return wide;
+    }
+    int len = MultiByteToWideChar(codePage, 0, text.data(), static_cast<int>(text.size()), nullptr, 0);
+    wide.resize(len);
+    len = MultiByteToWideChar(codePage, 0, text.data(), static_cast<int>(text.size()), wide.data(), len);
+    wide.resize(len);
+    return wide;
+}
+
+std::string WideToCodePage(std::wstring_view text, UINT codePage)
+{
+    if (text.empty())
+        return std::string();
+    std::string narrow;
+    if (const auto* pSingleByte = CSingleByteCodePage::Get(codePage))
+    {
+        narrow.resize(text.size());
+        narrow.resize(pSingleByte->FromWide(text.data(), text.size(), narrow.data()));
+        return narrow;
+    }
+    int len = WideCharToMultiByte(codePage, 0, text.data(), static_cast<int>(text.size()), nullptr, 0, nullptr, nullptr);
+    narrow.resize(len);
+    len = WideCharToMultiByte(codePage, 0, text.data(), static_cast<int>(text.size()), narrow.data(), len, nullptr, nullptr);
+    narrow.resize(len);
+    return narrow;
 }
 #ifdef UNICODE
 std::wstring UTF8ToString(const std::string& string, bool stopAtNull /* = true*/)
@@ -258,50 +319,196 @@ int LoadStringEx(HINSTANCE hInstance, UINT uID, LPWSTR lpBuffer, int nBufferMax,
     return ret;
 }
 
+void ScanTextBuffer(const void* pBuffer, int cb, int nullLimit, TextBufferStats& stats)
+{
+    stats               = TextBufferStats();
+    stats.scanned       = max(cb, 0);
+    const UINT8* pVal8  = static_cast<const UINT8*>(pBuffer);
+    int          nNeed  = 0; // continuation bytes the strict UTF8 check still expects
+    int          laxPos = 0; // next byte the lax UTF8 check looks at
+    bool         strict = true;
+
+    // all checks that have to look at a single byte which is not plain ASCII
+    auto scanByte = [&](int i) {
+        UINT8 zChar = pVal8[i];
+        if ((zChar == 0xC0) || (zChar == 0xC1) || (zChar >= 0xF5))
+            stats.illegalUTF8Bytes = true;
+        if (zChar & 0x80)
+            stats.nonAscii = true;
+
+        // the lax check only verifies the number of continuation bytes after a lead byte
+        if (!stats.laxUTF8Error && (i >= laxPos) && (i < cb - 4))
+        {
+            laxPos    = i + 1;
+            int extra = 0;
+            if ((zChar & 0xE0) == 0xC0)
+                extra = 1;
+            else if ((zChar & 0xF0) == 0xE0)
+                extra = 2;
+            else if ((zChar & 0xF8) == 0xF0)
+                extra = 3;
+            for (int j = 1; j <= extra; ++j)
+            {
+                if ((pVal8[i + j] & 0xC0) != 0x80)
+                    stats.laxUTF8Error = true;
+            }
+            if (extra && !stats.laxUTF8Error)
+            {
+                stats.laxUTF8Found = true;
+                laxPos += extra;
+            }
+        }
+
+        // the strict check: a null char resets the state, every error stops it
+        if (!strict)
+            return;
+        bool error = false;
+        if ((zChar & 0x80) == 0) // ASCII
+        {
+            if (zChar == 0)
+                nNeed = 0;
+            else if (nNeed)
+                error = true;
+        }
+        else if ((zChar & 0x40) == 0) // top bit
+        {
+            if (!nNeed)
+                error = true;
+            else
+                --nNeed;
+        }
+        else if (nNeed)
+            error = true;
+        else if ((zChar & 0x20) == 0) // top two bits
+        {
+            error = zChar <= 0xC1;
+            nNeed = error ? 0 : 1;
+        }
+        else if ((zChar & 0x10) == 0) // top three bits
+            nNeed = 2;
+        else if ((zChar & 0x08) == 0) // top four bits
+        {
+            error = zChar >= 0xF5;
+            nNeed = error ? 0 : 3;
+        }
+        else
+            error = true;
+        if (error)
+        {
+            strict              = false;
+            stats.utf8ErrorPos  = i;
+            stats.utf8ErrorSkip = nNeed;
+        }
+    };
+    auto countNull = [&](int i) {
+        ++stats.nullBytes;
+        if ((stats.nullBytes > nullLimit) && (stats.nullLimitPos < 0))
+            stats.nullLimitPos = i;
+    };
+
+    int i = 0;
+#if defined(_M_IX86) || defined(_M_X64)
+    if (sse2Supported)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= cb; i += 16)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pVal8 + i));
+            int     high  = _mm_movemask_epi8(chunk);
+            int     nulls = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, zero));
+            if (nulls)
+            {
+                // the block starts at an offset divisible by 16, so the words
+                // and dwords inside it are aligned relative to the buffer start
+                int words  = _mm_movemask_epi8(_mm_cmpeq_epi16(chunk, zero));
+                int dwords = _mm_movemask_epi8(_mm_cmpeq_epi32(chunk, zero));
+                stats.nullWords += static_cast<int>(std::bitset<16>(words & 0x5555).count());
+                stats.nullDwords += static_cast<int>(std::bitset<16>(dwords & 0x1111).count());
+                for (int j = 0; j < 16; ++j)
+                {
+                    if (nulls & (1 << j))
+                        countNull(i + j);
+                }
+            }
+            // plain ASCII without a pending UTF8 sequence does not change anything else
+            if ((high == 0) && (nNeed == 0))
+                continue;
+            for (int j = 0; j < 16; ++j)
+                scanByte(i + j);
+        }
+    }
+#endif
+    for (; i < cb; ++i)
+    {
+        if (pVal8[i] == 0)
+        {
+            countNull(i);
+            if (((i % 2) == 0) && (i + 1 < cb) && (pVal8[i + 1] == 0))
+                ++stats.nullWords;
+            if (((i % 4) == 0) && (i + 3 < cb) && (pVal8[i + 1] == 0) && (pVal8[i + 2] == 0) && (pVal8[i + 3] == 0))
+                ++stats.nullDwords;
+        }
+        scanByte(i);
+    }
+    stats.utf8Pending = nNeed;
+}
+
 int GetCodepageFromBuf(LPVOID pBuffer, int cb, bool& hasBOM, bool& inconclusive, int& skip)
+{
+    int confidence = 0;
+    return GetCodepageFromBuf(pBuffer, cb, 0, hasBOM, inconclusive, skip, confidence);
+}
+
+int GetCodepageFromBuf(const void* pBuffer, int cb, int sampleSize, bool& hasBOM, bool& inconclusive, int& skip, int& confidence)
 {
     inconclusive = false;
     hasBOM       = false;
     skip         = 0;
+    confidence   = 100;
     if (cb < 2)
     {
         inconclusive = true;
+        confidence   = 0;
         return CP_ACP;
     }
-    const UINT32* const pVal32 = static_cast<UINT32*>(pBuffer);
-    const UINT16* const pVal16 = static_cast<UINT16*>(pBuffer);
-    const UINT8* const  pVal8  = static_cast<UINT8*>(pBuffer);
+    const UINT8* const pVal8 = static_cast<const UINT8*>(pBuffer);
     if (cb >= 4)
     {
-        if (*pVal32 == 0x0000FEFF)
+        if ((pVal8[0] == 0xFF) && (pVal8[1] == 0xFE) && (pVal8[2] == 0) && (pVal8[3] == 0))
         {
             hasBOM = true;
             return 12000; // UTF32_LE
         }
-        if (*pVal32 == 0xFFFE0000)
+        if ((pVal8[0] == 0) && (pVal8[1] == 0) && (pVal8[2] == 0xFE) && (pVal8[3] == 0xFF))
         {
             hasBOM = true;
             return 12001; // UTF32_BE
         }
     }
-    // scan the whole buffer for a 0x00000000 sequence
-    // if found, we assume a binary file
-    int nDwords = cb / 4;
-    int nullCount = 0;
-    int maxNull   = max(1, nDwords / 256);
-    for (int i = 0; i < nDwords; ++i)
+    bool sampled = (sampleSize > 0) && (sampleSize < cb);
+    if (sampled)
+        cb = sampleSize;
+
+    // Use an arbitrary value of one fiftieth of the file length as
+    // the limit of null chars after which a file is considered UTF16.
+    // We do not want to treat an ASCII/UTF8 file as UTF16 just because
+    // of some null chars that might be accidentally in the file.
+    TextBufferStats stats;
+    ScanTextBuffer(pBuffer, cb, cb / 50, stats);
+
+    // a 0x00000000 sequence means a binary file
+    int maxNull = max(1, (cb / 4) / 256);
+    if (stats.nullDwords > maxNull)
     {
-        if (0x00000000 == pVal32[i])
-            ++nullCount;
-        if (nullCount > maxNull)
-            return -1;
+        confidence = 90;
+        return -1;
     }
-    if (*pVal16 == 0xFEFF)
+    if ((pVal8[0] == 0xFF) && (pVal8[1] == 0xFE))
     {
         hasBOM = true;
         return 1200; // UTF16_LE
     }
-    if (*pVal16 == 0xFFFE)
+    if ((pVal8[0] == 0xFE) && (pVal8[1] == 0xFF))
     {
         hasBOM = true;
         return 1201; // UTF16_BE
@@ -309,98 +516,41 @@ int GetCodepageFromBuf(LPVOID pBuffer, int cb, bool& hasBOM, bool& inconclusive,
     if (cb < 3)
     {
         inconclusive = true;
+        confidence   = 0;
         return CP_ACP;
     }
-    if (*pVal16 == 0xBBEF)
+    if ((pVal8[0] == 0xEF) && (pVal8[1] == 0xBB) && (pVal8[2] == 0xBF))
     {
-        if (pVal8[2] == 0xBF)
-        {
-            hasBOM = true;
-            return CP_UTF8;
-        }
+        hasBOM = true;
+        return CP_UTF8;
     }
-    // check for illegal UTF8 sequences
-    bool bNonAnsi  = false;
-    int  nNeedData = 0;
-    int  i         = 0;
-    nullCount = 0;
-    for (; i < cb; ++i)
+    if ((stats.nullLimitPos >= 0) && ((stats.utf8ErrorPos < 0) || (stats.nullLimitPos < stats.utf8ErrorPos)))
     {
-        UINT8 zChar = pVal8[i];
-        if ((zChar & 0x80) == 0) // ASCII
-        {
-            if (zChar == 0)
-            {
-                ++nullCount;
-                // count the null chars, we do not want to treat an ASCII/UTF8 file
-                // as UTF16 just because of some null chars that might be accidentally
-                // in the file.
-                // Use an arbitrary value of one fiftieth of the file length as
-                // the limit after which a file is considered UTF16.
-                if (nullCount > (cb / 50))
-                {
-                    // null-chars are not allowed for ASCII or UTF8, that means
-                    // this file is most likely UTF16 encoded
-                    if (i % 2)
-                        return 1200; // UTF16_LE
-                    else
-                        return 1201; // UTF16_BE
-                }
-                nNeedData = 0;
-            }
-            else if (nNeedData)
-            {
-                skip = nNeedData;
-                return CP_ACP;
-            }
-            continue;
-        }
+        // null-chars are not allowed for ASCII or UTF8, that means
+        // this file is most likely UTF16 encoded
+        confidence = 90;
+        if (stats.nullLimitPos % 2)
+            return 1200; // UTF16_LE
         else
-            bNonAnsi = true;
-        if ((zChar & 0x40) == 0) // top bit
-        {
-            if (!nNeedData)
-                return CP_ACP;
-            --nNeedData;
-        }
-        else if (nNeedData)
-        {
-            skip = nNeedData;
-            return CP_ACP;
-        }
-        else if ((zChar & 0x20) == 0) // top two bits
-        {
-            if (zChar <= 0xC1)
-            {
-                skip = nNeedData;
-                return CP_ACP;
-            }
-            nNeedData = 1;
-        }
-        else if ((zChar & 0x10) == 0) // top three bits
-        {
-            nNeedData = 2;
-        }
-        else if ((zChar & 0x08) == 0) // top four bits
-        {
-            if (zChar >= 0xf5)
-            {
-                skip = nNeedData;
-                return CP_ACP;
-            }
-            nNeedData = 3;
-        }
-        else
-        {
-            skip = nNeedData;
-            return CP_ACP;
-        }
+            return 1201; // UTF16_BE
     }
-    if (bNonAnsi && nNeedData == 0)
+    if (stats.utf8ErrorPos >= 0)
+    {
+        // illegal UTF8 sequence
+        skip = stats.utf8ErrorSkip;
+        return CP_ACP;
+    }
+    // an incomplete sequence at the end of a sample is cut off, not invalid
+    if (stats.nonAscii && ((stats.utf8Pending == 0) || sampled))
+    {
+        if (sampled)
+            confidence = 90;
         return CP_UTF8;
+    }
 
     inconclusive = true;
-    skip         = nNeedData;
+    confidence   = 0;
+    skip         = stats.utf8Pending;
 
     return CP_ACP;
 }
@@ -1,6 +1,6 @@
 ﻿// sktoolslib - common files for SK tools
 
-// Copyright (C) 2012-2013, 2020-2021, 2024 - Stefan Kueng
+// Copyright (C) 2012-2013, 2020-2021, 2024, 2026 - Stefan Kueng
 
 // This program is free software; you can redistribute it and/or
 // modify it under the terms of the GNU General Public License
@@ -20,6 +20,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 
 class CUnicodeUtils
 {
@@ -48,8 +49,57 @@ std::wstring MultibyteToWide(const std::string_view& multibyte, bool stopAtNull
 std::wstring UTF8ToWide(const std::string& multibyte, bool stopAtNull = true);
 std::wstring UTF8ToWide(const std::string_view& multibyte, bool stopAtNull = true);
 
+/// appends the UTF8 converted string to \c dst. No allocation happens if \c dst
+/// already has enough capacity, so a string reused across calls converts allocation free.
+/// Embedded null chars are converted as well. Returns the number of chars appended.
+size_t WideToUTF8(std::wstring_view wide, std::string& dst);
+/// appends the converted UTF8 string to \c dst, see WideToUTF8(std::wstring_view, std::string&)
+size_t UTF8ToWide(std::string_view multibyte, std::wstring& dst);
+/// converts into the caller buffer \c dst of \c dstSize chars. The result is not null terminated.
+/// Returns the number of chars required; if that's bigger than \c dstSize nothing is written.
+size_t WideToUTF8(std::wstring_view wide, char* dst, size_t dstSize);
+/// converts into the caller buffer \c dst, see WideToUTF8(std::wstring_view, char*, size_t)
+size_t UTF8ToWide(std::string_view multibyte, wchar_t* dst, size_t dstSize);
+/// converts into a buffer owned by the calling thread and returns a view of it.
+/// The view stays valid until the next call to this function on the same thread,
+/// so copy the result if it has to be kept or passed to another thread.
+std::string_view WideToUTF8Scratch(std::wstring_view wide);
+/// converts into a buffer owned by the calling thread, see WideToUTF8Scratch()
+std::wstring_view UTF8ToWideScratch(std::string_view multibyte);
+
+/// converts text in the code page \c codePage. The code pages of CSingleByteCodePage
+/// are converted with built-in tables, all others with the OS converters.
+std::wstring CodePageToWide(std::string_view text, UINT codePage);
+/// converts to the code page \c codePage, see CodePageToWide().
+/// Chars that the code page doesn't have are replaced with '?'.
+std::string  WideToCodePage(std::wstring_view text, UINT codePage);
+
+/// statistics of a text buffer used to detect its encoding, see ScanTextBuffer()
+struct TextBufferStats
+{
+    int  scanned          = 0;     ///< number of bytes scanned
+    int  nullBytes        = 0;     ///< number of null bytes
+    int  nullWords        = 0;     ///< number of 0x0000 words at even offsets
+    int  nullDwords       = 0;     ///< number of 0x00000000 dwords at offsets divisible by four
+    int  nullLimitPos     = -1;    ///< position of the first null byte exceeding the null limit, -1 if not exceeded
+    int  utf8ErrorPos     = -1;    ///< position of the first invalid UTF8 sequence, -1 if valid
+    int  utf8ErrorSkip    = 0;     ///< continuation bytes still expected at utf8ErrorPos
+    int  utf8Pending      = 0;     ///< continuation bytes still expected at the end of the buffer
+    bool nonAscii         = false; ///< at least one byte >= 0x80
+    bool illegalUTF8Bytes = false; ///< bytes that never appear in UTF8: 0xC0, 0xC1, 0xF5-0xFF
+    bool laxUTF8Found     = false; ///< lead bytes followed by the right number of continuation bytes were found
+    bool laxUTF8Error     = false; ///< a lead byte without enough continuation bytes was found
+};
+
+/// collects the statistics of a text buffer in a single pass.
+/// \param nullLimit the number of null bytes after which \c nullLimitPos is set
+void ScanTextBuffer(const void* pBuffer, int cb, int nullLimit, TextBufferStats& stats);
+
 /// determines the codepage from a text buffer. Returns -1 for binary
 int GetCodepageFromBuf(LPVOID pBuffer, int cb, bool& hasBOM, bool& inconclusive, int& skip);
+/// determines the codepage from the first \c sampleSize bytes of a text buffer (all of it if 0).
+/// \c confidence is set to a value from 0 (only ASCII was found) to 100 (BOM or invalid UTF8 found).
+int GetCodepageFromBuf(const void* pBuffer, int cb, int sampleSize, bool& hasBOM, bool& inconclusive, int& skip, int& confidence);
 
 #ifdef UNICODE
 std::wstring UTF8ToString(const std::string& string, bool stopAtNull = true);
@@ -1,6 +1,6 @@
 ﻿// sktoolslib - common files for SK tools
 
-// Copyright (C) 2025 - Stefan Kueng
+// Copyright (C) 2025-2026 - Stefan Kueng
 
 // This program is free software; you can redistribute it and/or
 // modify it under the terms of the GNU General Public License
@@ -18,6 +18,11 @@
 //
 #pragma once
 
+#if defined(_M_IX86) || defined(_M_X64)
+#    include <emmintrin.h>
+#    include <intrin.h>
+#endif
+
 // helper class to iterate over an utf-8 encoded string and return wide characters
 // used for regex_search with std::wregex
 //
@@ -207,3 +212,255 @@ private:
     static constexpr char32_t SURROGATE_TRAIL_FIRST         = 0xDC00;
     static constexpr char32_t UNICODE_REPLACEMENT_CHARACTER = 0xFFFD;
 };
+
+// same as Utf8ToWideIterator, but cheaper to move over text that is mostly
+// ASCII: the iterator looks ahead up to 256 bytes for the end of the current
+// run of ASCII chars, so moving inside such a run is just an increment of
+// the position. Only non-ASCII chars are decoded one by one.
+// Note that std::regex_search spends most of its time in the regex executor,
+// so a regex search gets only a little faster with this iterator.
+// The length of the text is needed so that the look-ahead and the
+// decoding never read past the end of the text.
+// Invalid sequences are split the same way in both directions: a lead byte
+// with the valid continuation bytes that follow it, a truncated sequence and
+// every stray continuation byte each become one U+FFFD.
+class Utf8ToWideBlockIterator
+{
+public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type        = wchar_t;
+    using difference_type   = ptrdiff_t;
+    using pointer           = wchar_t *;
+    using reference         = wchar_t &;
+
+    explicit Utf8ToWideBlockIterator(const unsigned char *text = nullptr, std::ptrdiff_t length = 0, std::ptrdiff_t position = 0) noexcept
+        : text(text)
+        , length(length)
+        , position(position)
+        , asciiEnd(position)
+        , characterIndex(0)
+        , lenBytes(0)
+        , lenCharacters(0)
+        , wcharBuf{}
+    {
+        if (text)
+            GetCodePoint();
+    }
+
+    value_type operator*() const noexcept
+    {
+        if (position < asciiEnd)
+            return text[position];
+        assert(lenCharacters != 0);
+        return wcharBuf[characterIndex];
+    }
+
+    Utf8ToWideBlockIterator &operator++() noexcept
+    {
+        if (position < asciiEnd)
+        {
+            // at the end of the run, find the next one or decode the next char
+            if (++position == asciiEnd)
+                GetCodePoint();
+        }
+        else if ((characterIndex + 1) < lenCharacters)
+            characterIndex++;
+        else
+        {
+            position += lenBytes;
+            GetCodePoint();
+            characterIndex = 0;
+        }
+        return *this;
+    }
+
+    Utf8ToWideBlockIterator operator++(int) noexcept
+    {
+        Utf8ToWideBlockIterator ret(*this);
+        operator++();
+        return ret;
+    }
+
+    Utf8ToWideBlockIterator &operator--() noexcept
+    {
+        if ((position >= asciiEnd) && characterIndex)
+            characterIndex--;
+        else if ((position > 0) && (text[position - 1] < 0x80))
+        {
+            // the bytes from the previous one up to the current
+            // position or the end of the current run are ASCII
+            if (position >= asciiEnd)
+                asciiEnd = position;
+            --position;
+            characterIndex = 0;
+        }
+        else
+        {
+            // find the lead byte of the previous char. If the sequence that
+            // starts there does not end at the current position, the byte
+            // before the current position is a stray continuation byte
+            auto end = position;
+            position = end - 1;
+            while ((position > 0) && (end - position < MAX_SEQUENCE_LENGTH) && ((text[position] & 0xC0) == 0x80))
+                --position;
+
+            GetCodePoint();
+            if ((asciiEnd > position) || (position + lenBytes != end))
+            {
+                position = end - 1;
+                GetCodePoint();
+            }
+            characterIndex = lenCharacters ? lenCharacters - 1 : 0;
+        }
+        return *this;
+    }
+
+    Utf8ToWideBlockIterator operator--(int) noexcept
+    {
+        Utf8ToWideBlockIterator ret(*this);
+        operator--();
+        return ret;
+    }
+
+    bool operator==(const Utf8ToWideBlockIterator &other) const noexcept
+    {
+        // iterators are only compared for the same text
+        return position == other.position &&
+               characterIndex == other.characterIndex;
+    }
+
+    bool operator!=(const Utf8ToWideBlockIterator &other) const noexcept
+    {
+        return !operator==(other);
+    }
+
+    std::ptrdiff_t CurrentPos() const noexcept
+    {
+        return position;
+    }
+
+private:
+    static constexpr std::ptrdiff_t LOOK_AHEAD          = 256;
+    static constexpr std::ptrdiff_t MAX_SEQUENCE_LENGTH = 6;
+
+    // finds the end of the ASCII run that starts at the current position
+    std::ptrdiff_t FindAsciiEnd() const noexcept
+    {
+        std::ptrdiff_t end   = position;
+        std::ptrdiff_t limit = (length - position > LOOK_AHEAD) ? position + LOOK_AHEAD : length;
+#if defined(_M_IX86) || defined(_M_X64)
+        for (; end + 16 <= limit; end += 16)
+        {
+            int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(text + end)));
+            if (mask)
+            {
+                unsigned long bit = 0;
+                _BitScanForward(&bit, mask);
+                return end + bit;
+            }
+        }
+#endif
+        while ((end < limit) && (text[end] < 0x80))
+            ++end;
+        return end;
+    }
+
+    void GetCodePoint() noexcept
+    {
+        if (position >= length)
+        {
+            asciiEnd      = position;
+            lenBytes      = 0;
+            lenCharacters = 0;
+            return;
+        }
+        asciiEnd = FindAsciiEnd();
+        if (asciiEnd > position)
+            return;
+
+        // decode the non-ASCII char
+        char32_t             codePoint   = 0;
+        unsigned int         sequenceLen = 1;
+        const unsigned char *pBuf        = (text + position);
+        if (*pBuf < 0xC0)
+        {
+            // Invalid leading byte
+            codePoint = UNICODE_REPLACEMENT_CHARACTER;
+        }
+        else if (*pBuf < 0xE0)
+        {
+            codePoint   = *pBuf & 0x1F;
+            sequenceLen = 2;
+        }
+        else if (*pBuf < 0xF0)
+        {
+            codePoint   = *pBuf & 0x0F;
+            sequenceLen = 3;
+        }
+        else if (*pBuf < 0xF8)
+        {
+            codePoint   = *pBuf & 0x07;
+            sequenceLen = 4;
+        }
+        else if (*pBuf < 0xFC)
+        {
+            codePoint   = *pBuf & 0x03;
+            sequenceLen = 5;
+        }
+        else if (*pBuf < 0xFE)
+        {
+            codePoint   = *pBuf & 0x01;
+            sequenceLen = 6;
+        }
+        else
+        {
+            // Invalid leading byte
+            codePoint = UNICODE_REPLACEMENT_CHARACTER;
+        }
+
+        auto available = length - position;
+        lenBytes       = 1;
+        for (; lenBytes < sequenceLen; ++lenBytes)
+        {
+            if ((lenBytes >= available) || ((pBuf[lenBytes] & 0xC0) != 0x80))
+            {
+                // truncated sequence or invalid continuation byte: the bytes
+                // up to here become one replacement char
+                codePoint = UNICODE_REPLACEMENT_CHARACTER;
+                break;
+            }
+            codePoint = (codePoint << 6) | (pBuf[lenBytes] & 0x3F);
+        }
+        if (codePoint > UNICODE_LAST_CODEPOINT)
+            codePoint = UNICODE_REPLACEMENT_CHARACTER;
+
+        if ((codePoint == UNICODE_REPLACEMENT_CHARACTER) || (codePoint < SUPPLEMENTAL_PLANE_FIRST))
+        {
+            wcharBuf[0]   = static_cast<wchar_t>(codePoint);
+            lenCharacters = 1;
+        }
+        else
+        {
+            wcharBuf[0]   = static_cast<wchar_t>(((codePoint - SUPPLEMENTAL_PLANE_FIRST) >> 10) + SURROGATE_LEAD_FIRST);
+            wcharBuf[1]   = static_cast<wchar_t>((codePoint & 0x3ff) + SURROGATE_TRAIL_FIRST);
+            lenCharacters = 2;
+        }
+    }
+
+    const unsigned char      *text;
+    std::ptrdiff_t            length;
+    std::ptrdiff_t            position;
+    std::ptrdiff_t            asciiEnd; ///< the bytes from position up to here are ASCII
+    size_t                    characterIndex;
+
+    // members to cache the current non-ASCII codepoint in utf-16
+    unsigned int              lenBytes;
+    size_t                    lenCharacters;
+    wchar_t                   wcharBuf[2];
+
+    static constexpr char32_t SUPPLEMENTAL_PLANE_FIRST      = 0x10000;
+    static constexpr char32_t SURROGATE_LEAD_FIRST          = 0xD800;
+    static constexpr char32_t SURROGATE_TRAIL_FIRST         = 0xDC00;
+    static constexpr char32_t UNICODE_REPLACEMENT_CHARACTER = 0xFFFD;
+    static constexpr char32_t UNICODE_LAST_CODEPOINT        = 0x10FFFF;
+};
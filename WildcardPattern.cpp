@@ -0,0 +1,222 @@
+// sktoolslib - common files for SK tools
+
+// Copyright (C) 2026 - Stefan Kueng
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+#include "stdafx.h"
+#include "WildcardPattern.h"
+#include "CaseFold.h"
+
+#include <algorithm>
+
+namespace
+{
+// lower cases the same way as wcswildicmp()
+void ToLower(std::wstring_view src, std::wstring& dst)
+{
+    dst.resize(src.size());
+    for (size_t i = 0; i < src.size(); ++i)
+        dst[i] = CCaseFold::Fold(src[i]);
+}
+
+// returns a buffer with the lower cased name, reused by the calling thread
+std::wstring_view LoweredName(std::wstring_view name)
+{
+    thread_local std::wstring buffer;
+    ToLower(name, buffer);
+    return buffer;
+}
+
+// removes repeated '*', since "**" matches the same as "*"
+std::wstring NormalizePattern(std::wstring_view pattern, bool caseInsensitive)
+{
+    std::wstring result;
+    if (caseInsensitive)
+        ToLower(pattern, result);
+    else
+        result = pattern;
+    result.erase(std::unique(result.begin(), result.end(), [](wchar_t a, wchar_t b) { return (a == '*') && (b == '*'); }), result.end());
+    return result;
+}
+} // namespace
+
+bool CWildcardPattern::SegmentMatches(const Segment& segment, const wchar_t* str)
+{
+    if (!segment.hasJoker)
+        return wmemcmp(segment.text.c_str(), str, segment.text.size()) == 0;
+    for (size_t i = 0; i < segment.text.size(); ++i)
+    {
+        if ((segment.text[i] != '?') && (segment.text[i] != str[i]))
+            return false;
+    }
+    return true;
+}
+
+// finds the first position >= pos where the segment matches and ends before end
+size_t CWildcardPattern::FindSegment(const Segment& segment, std::wstring_view name, size_t pos, size_t end)
+{
+    if (!segment.hasJoker)
+        return name.substr(0, end).find(segment.text, pos);
+    for (; pos + segment.text.size() <= end; ++pos)
+    {
+        if (SegmentMatches(segment, name.data() + pos))
+            return pos;
+    }
+    return std::wstring_view::npos;
+}
+
+CWildcardPattern::CWildcardPattern(std::wstring_view pattern, bool caseInsensitive)
+{
+    Compile(pattern, caseInsensitive);
+}
+
+void CWildcardPattern::Compile(std::wstring_view pattern, bool caseInsensitive)
+{
+    this->caseInsensitive = caseInsensitive;
+    std::wstring normalized = NormalizePattern(pattern, caseInsensitive);
+
+    std::vector<Segment> segments;
+    size_t               start = 0;
+    for (;;)
+    {
+        size_t  star = normalized.find('*', start);
+        Segment segment;
+        segment.text     = normalized.substr(start, star == std::wstring::npos ? std::wstring::npos : star - start);
+        segment.hasJoker = segment.text.find('?') != std::wstring::npos;
+        segments.push_back(std::move(segment));
+        if (star == std::wstring::npos)
+            break;
+        start = star + 1;
+    }
+
+    hasStar = segments.size() > 1;
+    prefix  = std::move(segments.front());
+    suffix  = Segment();
+    middle.clear();
+    if (hasStar)
+    {
+        suffix = std::move(segments.back());
+        middle.assign(std::make_move_iterator(segments.begin() + 1), std::make_move_iterator(segments.end() - 1));
+    }
+    minLength = prefix.text.size() + suffix.text.size();
+    for (const auto& segment : middle)
+        minLength += segment.text.size();
+}
+
+bool CWildcardPattern::Match(std::wstring_view name) const
+{
+    return MatchLowered(caseInsensitive ? LoweredName(name) : name);
+}
+
+bool CWildcardPattern::MatchLowered(std::wstring_view name) const
+{
+    if (!hasStar)
+        return (name.size() == prefix.text.size()) && SegmentMatches(prefix, name.data());
+    if (name.size() < minLength)
+        return false;
+    if (!SegmentMatches(prefix, name.data()) || !SegmentMatches(suffix, name.data() + name.size() - suffix.text.size()))
+        return false;
+    // the leftmost match of every segment leaves the most room for the next ones
+    size_t pos = prefix.text.size();
+    size_t end = name.size() - suffix.text.size();
+    for (const auto& segment : middle)
+    {
+        pos = FindSegment(segment, name, pos, end);
+        if (pos == std::wstring_view::npos)
+            return false;
+        pos += segment.text.size();
+    }
+    return true;
+}
+
+CWildcardSet::CWildcardSet(bool caseInsensitive)
+    : caseInsensitive(caseInsensitive)
+    , count(0)
+{
+}
+
+void CWildcardSet::Add(std::wstring_view pattern)
+{
+    ++count;
+    std::wstring normalized = NormalizePattern(pattern, caseInsensitive);
+    size_t       stars      = std::count(normalized.begin(), normalized.end(), '*');
+    bool         hasJoker   = normalized.find('?') != std::wstring::npos;
+    if (!hasJoker && (stars == 0))
+    {
+        exact.insert(storage.emplace_back(std::move(normalized)));
+        return;
+    }
+    if (!hasJoker && (stars == 1) && (normalized.front() == '*'))
+    {
+        AddLiteral(suffixes, std::wstring_view(storage.emplace_back(std::move(normalized))).substr(1));
+        return;
+    }
+    if (!hasJoker && (stars == 1) && (normalized.back() == '*'))
+    {
+        std::wstring_view stored = storage.emplace_back(std::move(normalized));
+        AddLiteral(prefixes, stored.substr(0, stored.size() - 1));
+        return;
+    }
+    patterns.emplace_back(normalized, false);
+}
+
+void CWildcardSet::Clear()
+{
+    count = 0;
+    exact.clear();
+    prefixes.clear();
+    suffixes.clear();
+    patterns.clear();
+    storage.clear();
+}
+
+void CWildcardSet::AddLiteral(std::vector<LiteralBucket>& buckets, std::wstring_view literal)
+{
+    for (auto& bucket : buckets)
+    {
+        if (bucket.length == literal.size())
+        {
+            bucket.literals.insert(literal);
+            return;
+        }
+    }
+    buckets.push_back({literal.size(), {literal}});
+}
+
+bool CWildcardSet::Match(std::wstring_view name) const
+{
+    if (caseInsensitive)
+        name = LoweredName(name);
+    if (exact.find(name) != exact.end())
+        return true;
+    for (const auto& bucket : suffixes)
+    {
+        if ((bucket.length <= name.size()) && (bucket.literals.find(name.substr(name.size() - bucket.length)) != bucket.literals.end()))
+            return true;
+    }
+    for (const auto& bucket : prefixes)
+    {
+        if ((bucket.length <= name.size()) && (bucket.literals.find(name.substr(0, bucket.length)) != bucket.literals.end()))
+            return true;
+    }
+    for (const auto& pattern : patterns)
+    {
+        if (pattern.MatchLowered(name))
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,107 @@
+// sktoolslib - common files for SK tools
+
+// Copyright (C) 2026 - Stefan Kueng
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+#pragma once
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * a wild card pattern with the syntax of wcswildcmp(): '*' matches any
+ * number of chars, '?' matches exactly one char.
+ * The pattern is split at the '*' into literal segments once, matching then
+ * only compares the anchored first and last segment and searches the others
+ * from left to right, without backtracking.
+ */
+class CWildcardPattern
+{
+public:
+    CWildcardPattern() = default;
+    CWildcardPattern(std::wstring_view pattern, bool caseInsensitive = false);
+
+    void Compile(std::wstring_view pattern, bool caseInsensitive = false);
+
+    /// returns true if the pattern matches the whole name
+    bool Match(std::wstring_view name) const;
+
+private:
+    friend class CWildcardSet;
+
+    struct Segment
+    {
+        std::wstring text;
+        bool         hasJoker = false; ///< contains a '?'
+    };
+
+    bool          MatchLowered(std::wstring_view name) const;
+    static bool   SegmentMatches(const Segment& segment, const wchar_t* str);
+    static size_t FindSegment(const Segment& segment, std::wstring_view name, size_t pos, size_t end);
+
+    Segment              prefix;
+    Segment              suffix;
+    std::vector<Segment> middle;
+    size_t               minLength       = 0;
+    bool                 hasStar         = false;
+    bool                 caseInsensitive = false;
+};
+
+/**
+ * matches a name against many wild card patterns at once, e.g. the include
+ * or exclude filters of a file search.
+ * Patterns without wild cards, and patterns that are a literal with one '*'
+ * at the start or the end (like "*.cpp" or "readme*") are stored in hash
+ * sets, so these need only one lookup per distinct literal length. All other
+ * patterns are checked one by one with CWildcardPattern.
+ */
+class CWildcardSet
+{
+public:
+    CWildcardSet(bool caseInsensitive = false);
+    CWildcardSet(const CWildcardSet&)            = delete;
+    CWildcardSet& operator=(const CWildcardSet&) = delete;
+    CWildcardSet(CWildcardSet&&)                 = default;
+    CWildcardSet& operator=(CWildcardSet&&)      = default;
+
+    void Add(std::wstring_view pattern);
+    void Clear();
+    bool empty() const { return (count == 0); }
+
+    /// returns true if at least one of the patterns matches the name
+    bool Match(std::wstring_view name) const;
+
+private:
+    struct LiteralBucket
+    {
+        size_t                                length;
+        std::unordered_set<std::wstring_view> literals;
+    };
+
+    static void AddLiteral(std::vector<LiteralBucket>& buckets, std::wstring_view literal);
+
+    bool                                  caseInsensitive;
+    size_t                                count;
+    std::deque<std::wstring>              storage; // owns the strings of the hash sets
+    std::unordered_set<std::wstring_view> exact;
+    std::vector<LiteralBucket>            prefixes;
+    std::vector<LiteralBucket>            suffixes;
+    std::vector<CWildcardPattern>         patterns;
+};
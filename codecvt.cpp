@@ -1,5 +1,8 @@
 #include "stdafx.h"
 #include "codecvt.h"
+#include "UTFTranscoder.h"
+
+#include <cstring>
 
 using namespace std;
 
@@ -8,22 +11,23 @@ Ucs2Conversion::result
                            const char* from, const char* fromEnd, const char*& fromNext,
                            wchar_t* to, wchar_t* toLimit, wchar_t*& toNext) const
 {
-    size_t maxInput  = (fromEnd - from) & ~1;
+    size_t maxInput  = (fromEnd - from) / 2;
     size_t maxOutput = (toLimit - to);
-    size_t count     = min(maxInput / 2, maxOutput);
-
-    result res = ok;
+    size_t count     = min(maxInput, maxOutput);
 
-    fromNext = from;
-    toNext   = to;
-    for (; count--; fromNext += 2, ++toNext)
+    if constexpr (sizeof(wchar_t) == 2)
+    {
+        // UCS-2 LE is the memory layout of wchar_t, no need to shuffle bytes
+        memcpy(to, from, count * 2);
+    }
+    else
     {
-        unsigned char c1 = *fromNext, c2 = *(fromNext + 1);
-        *toNext = c1 | c2 << 8;
+        for (size_t i = 0; i < count; ++i)
+            to[i] = static_cast<unsigned char>(from[2 * i]) | static_cast<unsigned char>(from[2 * i + 1]) << 8;
     }
-    if (toNext == to && fromNext == fromEnd - 1)
-        res = partial;
-    return res;
+    fromNext = from + count * 2;
+    toNext   = to + count;
+    return (fromNext == fromEnd) ? ok : partial;
 }
 
 Ucs2Conversion::result
@@ -32,108 +36,206 @@ Ucs2Conversion::result
                             char* to, char* toLimit, char*& toNext) const
 {
     size_t maxInput  = (fromEnd - from);
-    size_t maxOutput = (toLimit - to) & ~1;
-    size_t count     = min(maxInput, maxOutput / 2);
+    size_t maxOutput = (toLimit - to) / 2;
+    size_t count     = min(maxInput, maxOutput);
 
-    fromNext = from;
-    toNext   = to;
-    for (; count--; ++fromNext, toNext += 2)
+    if constexpr (sizeof(wchar_t) == 2)
+        memcpy(to, from, count * 2);
+    else
     {
-        *(toNext + 0) = static_cast<char>(*fromNext & 0xFF);
-        *(toNext + 1) = static_cast<char>(*fromNext >> 8 & 0xFF);
+        for (size_t i = 0; i < count; ++i)
+        {
+            to[2 * i]     = static_cast<char>(from[i] & 0xFF);
+            to[2 * i + 1] = static_cast<char>(from[i] >> 8 & 0xFF);
+        }
     }
-    return ok;
+    fromNext = from + count;
+    toNext   = to + count * 2;
+    return (fromNext == fromEnd) ? ok : partial;
 }
 
-inline unsigned char
-    take6Bits(unsigned value, size_t rightPosition)
+// the UTF8 facet keeps half of a surrogate pair in the state:
+// the low surrogate that didn't fit into the output when reading,
+// the high surrogate that waits for its low surrogate when writing
+static wchar_t GetPendingSurrogate(const mbstate_t& state)
 {
-    return static_cast<unsigned char>((value >> rightPosition) & 63);
+    unsigned short pending = 0;
+    memcpy(&pending, &state, sizeof(pending));
+    return static_cast<wchar_t>(pending);
 }
 
-inline size_t
-    mostSignifantBitPosition(unsigned value)
+static void SetPendingSurrogate(mbstate_t& state, wchar_t pending)
 {
-    size_t result(0);
+    auto value = static_cast<unsigned short>(pending);
+    memcpy(&state, &value, sizeof(value));
+}
 
-    size_t half = 16;
-    for (; half > 0; half >>= 1)
+static size_t SequenceLength(unsigned char lead)
+{
+    if ((lead >= 0xC2) && (lead <= 0xDF))
+        return 2;
+    if ((lead >= 0xE0) && (lead <= 0xEF))
+        return 3;
+    if ((lead >= 0xF0) && (lead <= 0xF4))
+        return 4;
+    return 1;
+}
+
+// returns the length of the buffer without an incomplete sequence at its end
+static size_t CompleteLength(const char* buf, size_t len)
+{
+    const auto* s = reinterpret_cast<const unsigned char*>(buf);
+    for (size_t k = 1; (k <= 3) && (k <= len); ++k)
     {
-        if (1u << (result + half) <= value)
-            result += half;
+        unsigned char c = s[len - k];
+        if ((c & 0xC0) == 0x80)
+            continue;
+        if (SequenceLength(c) > k)
+            return len - k;
+        break;
     }
-    return result + 1;
-    //return *lower_bound(range(0u, 31u), \x -> (1 << x <= value));
+    return len;
 }
 
 UTF8Conversion::result
-    UTF8Conversion::do_in(mbstate_t&,
+    UTF8Conversion::do_in(mbstate_t& state,
                            const char* from, const char* fromEnd, const char*& fromNext,
                            wchar_t* to, wchar_t* toLimit, wchar_t*& toNext) const
 {
     fromNext = from;
     toNext   = to;
 
-    for (; toNext < toLimit && fromNext < fromEnd; ++toNext)
+    wchar_t pending = GetPendingSurrogate(state);
+    if (pending)
     {
-        if (static_cast<unsigned char>(*fromNext) < 0x80)
-            *toNext = static_cast<unsigned char>(*fromNext++);
-        else
-        {
-            // 111zxxxx : z = 0 xxxx are data bits
-            size_t zeroBitPos = mostSignifantBitPosition(~*fromNext);
-            size_t extraBytes = 7 - zeroBitPos;
-
-            if (static_cast<size_t>(fromEnd - fromNext) < extraBytes + 1)
-                return partial;
+        if (toNext == toLimit)
+            return partial;
+        *toNext++ = pending;
+        SetPendingSurrogate(state, 0);
+    }
 
-            *toNext = static_cast<unsigned char>(*fromNext++) & static_cast<wchar_t>((1 << (zeroBitPos - 1)) - 1);
+    while ((fromNext < fromEnd) && (toNext < toLimit))
+    {
+        // every byte converts to at most one wchar_t, so as many bytes as the
+        // output has room for can be converted at once
+        size_t count = CompleteLength(fromNext, min(static_cast<size_t>(fromEnd - fromNext), static_cast<size_t>(toLimit - toNext)));
+        if (count > 0)
+        {
+            toNext += UTFTranscoder::UTF8ToUTF16(fromNext, count, toNext);
+            fromNext += count;
+            continue;
+        }
 
-            for (; extraBytes--; ++fromNext)
-            {
-                *toNext = *toNext << 6 | static_cast<unsigned char>(*fromNext) & 63;
-            }
+        // the sequence is longer than the room left in the output,
+        // or the input ends in the middle of it
+        size_t available = fromEnd - fromNext;
+        if (CompleteLength(fromNext, available) == 0)
+            break;
+        size_t   i  = 0;
+        char32_t cp = UTFTranscoder::DecodeUTF8(reinterpret_cast<const unsigned char*>(fromNext), available, i);
+        fromNext += i;
+        if (cp >= 0x10000)
+        {
+            cp -= 0x10000;
+            *toNext++ = static_cast<wchar_t>(0xD800 + (cp >> 10));
+            SetPendingSurrogate(state, static_cast<wchar_t>(0xDC00 + (cp & 0x3FF)));
+            break;
         }
+        *toNext++ = static_cast<wchar_t>(cp);
     }
 
-    return ok;
+    return (fromNext == fromEnd) ? ok : partial;
 }
 
 UTF8Conversion::result
-    UTF8Conversion::do_out(mbstate_t&,
+    UTF8Conversion::do_out(mbstate_t& state,
                             const wchar_t* from, const wchar_t* fromEnd, const wchar_t*& fromNext,
                             char* to, char* toLimit, char*& toNext) const
 {
     fromNext = from;
     toNext   = to;
 
-    for (; fromNext < fromEnd; ++fromNext)
+    wchar_t pending = GetPendingSurrogate(state);
+    if (pending && (fromNext < fromEnd))
     {
-        unsigned symbol = *fromNext;
+        wchar_t pair[2] = {pending, *fromNext};
+        size_t  count   = IS_LOW_SURROGATE(*fromNext) ? 2 : 1;
+        if (static_cast<size_t>(toLimit - toNext) < UTFTranscoder::UTF8Length(pair, count))
+            return partial;
+        toNext += UTFTranscoder::UTF16ToUTF8(pair, count, toNext);
+        fromNext += count - 1;
+        SetPendingSurrogate(state, 0);
+    }
 
-        if (symbol < 0x7F)
+    while ((fromNext < fromEnd) && (toNext < toLimit))
+    {
+        // a wchar_t converts to at most three bytes
+        size_t count = min(static_cast<size_t>(fromEnd - fromNext), static_cast<size_t>(toLimit - toNext) / 3);
+        if ((count > 0) && IS_HIGH_SURROGATE(fromNext[count - 1]))
+            --count; // don't split a surrogate pair
+        if (count > 0)
         {
-            if (toNext < toLimit)
-                *toNext++ = static_cast<unsigned char>(symbol);
-            else
-                return ok;
+            toNext += UTFTranscoder::UTF16ToUTF8(fromNext, count, toNext);
+            fromNext += count;
+            continue;
         }
-        else
-        {
-            size_t msbPos     = mostSignifantBitPosition(symbol);
-            size_t extraBytes = msbPos / 6;
 
-            if (static_cast<size_t>(toLimit - toNext) >= extraBytes + 1)
+        count = 1;
+        if (IS_HIGH_SURROGATE(*fromNext))
+        {
+            if (fromNext + 1 == fromEnd)
             {
-                *toNext = static_cast<unsigned char>(0xFF80 >> extraBytes);
-                *toNext++ |= take6Bits(symbol, extraBytes * 6);
-
-                for (; extraBytes--;)
-                    *toNext++ = 0x80 | take6Bits(symbol, extraBytes * 6);
+                // the low surrogate comes with the next call
+                SetPendingSurrogate(state, *fromNext++);
+                break;
             }
-            else
-                return ok;
+            if (IS_LOW_SURROGATE(fromNext[1]))
+                count = 2;
         }
+        if (static_cast<size_t>(toLimit - toNext) < UTFTranscoder::UTF8Length(fromNext, count))
+            break;
+        toNext += UTFTranscoder::UTF16ToUTF8(fromNext, count, toNext);
+        fromNext += count;
     }
+    return (fromNext == fromEnd) ? ok : partial;
+}
+
+UTF8Conversion::result
+    UTF8Conversion::do_unshift(mbstate_t& state,
+                                char* to, char* toLimit, char*& toNext) const
+{
+    toNext = to;
+    if (!GetPendingSurrogate(state))
+        return noconv;
+    // a high surrogate without its low surrogate
+    wchar_t replacement = 0xFFFD;
+    if (static_cast<size_t>(toLimit - to) < UTFTranscoder::UTF8Length(&replacement, 1))
+        return partial;
+    toNext += UTFTranscoder::UTF16ToUTF8(&replacement, 1, to);
+    SetPendingSurrogate(state, 0);
     return ok;
 }
+
+int UTF8Conversion::do_length(mbstate_t& state,
+                              const char* from, const char* fromEnd, size_t max) const
+{
+    const auto* s     = reinterpret_cast<const unsigned char*>(from);
+    size_t      len   = CompleteLength(from, fromEnd - from);
+    size_t      i     = 0;
+    size_t      count = 0;
+    if (GetPendingSurrogate(state) && (max > 0))
+    {
+        SetPendingSurrogate(state, 0);
+        ++count;
+    }
+    while ((i < len) && (count < max))
+    {
+        size_t   next = i;
+        char32_t cp   = UTFTranscoder::DecodeUTF8(s, len, next);
+        if ((cp >= 0x10000) && (count + 2 > max))
+            break;
+        count += (cp >= 0x10000) ? 2 : 1;
+        i = next;
+    }
+    return static_cast<int>(i);
+}
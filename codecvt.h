@@ -38,9 +38,24 @@ protected:
 
     bool do_always_noconv() const throw() override { return false; }
     int  do_encoding() const throw() override { return 2; }
+    int  do_max_length() const throw() override { return 2; }
 };
 
-/** Conversion facet that allows to read Unicode files in UTF-8 encoding */
+/** Conversion facet that allows to read Unicode files in UTF-8 encoding.
+
+    Characters outside the BMP are converted to and from surrogate pairs.
+    When only one wchar_t fits into the output, or the input ends between
+    the two halves of a pair, the other half is kept in the state and
+    returned by the next call.
+    Invalid UTF-8 sequences are converted to U+FFFD.
+
+    Limitation: MSVC's basic_filebuf converts one wchar_t per call and
+    returns eof at the end of the file without calling in() again. If the
+    last character of a file is outside the BMP, a wifstream therefore only
+    reads its high surrogate; the low surrogate is lost. Read such files
+    into memory and convert them in one call, or make sure they end with
+    a character from the BMP (e.g. a line break).
+*/
 class UTF8Conversion
     : public std::codecvt<wchar_t, char, std::mbstate_t>
 {
@@ -53,7 +68,14 @@ protected:
                   const wchar_t* from, const wchar_t* fromEnd, const wchar_t*& fromNext,
                   char* to, char* toLimit, char*& toNext) const override;
 
+    result do_unshift(std::mbstate_t& state,
+                      char* to, char* toLimit, char*& toNext) const override;
+
+    int do_length(std::mbstate_t& state,
+                  const char* from, const char* fromEnd, size_t max) const override;
+
     bool do_always_noconv() const throw() override { return false; }
-    int  do_encoding() const throw() override { return 2; }
+    int  do_encoding() const throw() override { return 0; }
+    int  do_max_length() const throw() override { return 4; }
 };
 #pragma warning(pop)